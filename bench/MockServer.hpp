@@ -0,0 +1,272 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <charconv>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <ctime>
+
+/*
+
+In-process stand-in for the marketstack API, answering /v1/tickers/<symbol>
+and /v1/intraday with synthetic data over HTTP/1.1 keep-alive on localhost.
+
+Every ticker has `bars` 30 minute bars, served `page_size` at a time. Pages
+are rendered once up front (prices don't depend on the symbol), so serving
+costs little more than the socket writes and the benchmark measures the
+client. Every response is delayed by `latency` to stand in for the network.
+
+*/
+struct MockServer
+{
+    struct Options
+    {
+        std::size_t bars      = 2500;
+        std::size_t page_size = 1000;
+        std::chrono::microseconds latency{ 0 };
+    };
+
+    MockServer(Options _options) :
+        options(_options)
+    {
+        options.page_size = std::max<std::size_t>(options.page_size, 1);
+        render();
+
+        listener = ::socket(AF_INET, SOCK_STREAM, 0);
+        assert(listener >= 0);
+
+        int yes = 1;
+        ::setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+        sockaddr_in address{};
+        address.sin_family      = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port        = 0;
+
+        [[maybe_unused]] const auto bound = ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        assert(bound == 0);
+        ::listen(listener, 128);
+
+        socklen_t length = sizeof(address);
+        ::getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length);
+        port = ntohs(address.sin_port);
+
+        acceptor = std::thread([this]() { accept(); });
+    }
+
+    MockServer(MockServer&&) = delete;
+    MockServer(const MockServer&) = delete;
+
+    ~MockServer()
+    {
+        stopping = true;
+        ::shutdown(listener, SHUT_RDWR);
+        ::close(listener);
+        acceptor.join();
+
+        // workers close their own connection once it's shut down
+        std::vector<std::thread> joining;
+        {
+            std::lock_guard lock(mutex);
+            for (const int c : connections) ::shutdown(c, SHUT_RDWR);
+            joining = std::move(workers);
+        }
+        for (auto& t : joining) t.join();
+    }
+
+    std::string url() const
+    {
+        return "http://127.0.0.1:" + std::to_string(port);
+    }
+
+    // CPU time spent by the server's own threads, in seconds
+    double cpu() const
+    {
+        return static_cast<double>(cpu_ns.load()) * 1e-9;
+    }
+
+    std::atomic<std::size_t> requests = 0;
+
+private:
+    void render()
+    {
+        const std::size_t pages = (options.bars + options.page_size - 1) / options.page_size;
+        bodies.reserve(pages + 1);
+
+        // 2023-01-02T00:00:00Z, one bar every 30 minutes
+        const std::time_t start = 1672617600;
+        double price = 100.0;
+        uint64_t state = 0x9e3779b97f4a7c15ull;
+
+        char row[256];
+        // one page past the end stays empty, for offsets beyond the total
+        for (std::size_t page = 0; page <= pages; page++)
+        {
+            const auto offset = page * options.page_size;
+            const auto count  = std::min(options.page_size, options.bars - std::min(offset, options.bars));
+
+            std::string body;
+            body.reserve(count * 160 + 128);
+            body += "{\"pagination\":{\"limit\":" + std::to_string(options.page_size)
+                  + ",\"offset\":" + std::to_string(offset)
+                  + ",\"count\":"  + std::to_string(count)
+                  + ",\"total\":"  + std::to_string(options.bars) + "},\"data\":[";
+
+            for (std::size_t i = 0; i < count; i++)
+            {
+                state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+                const double move = (static_cast<double>(state % 2001) - 1000.0) * 1e-5;
+                const double open = price;
+                price *= 1.0 + move;
+
+                const std::time_t t = start + static_cast<std::time_t>(offset + i) * 1800;
+                std::tm tm;
+                ::gmtime_r(&t, &tm);
+
+                const int n = std::snprintf(row, sizeof(row),
+                    "%s{\"open\":%.4f,\"high\":%.4f,\"low\":%.4f,\"close\":%.4f,\"last\":%.4f,\"volume\":%llu,"
+                    "\"date\":\"%04d-%02d-%02dT%02d:%02d:00+0000\"}",
+                    i ? "," : "",
+                    open, std::max(open, price) * 1.001, std::min(open, price) * 0.999, price, price,
+                    static_cast<unsigned long long>(state % 100000),
+                    tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min);
+                body.append(row, n);
+            }
+
+            body += "]}";
+            bodies.push_back(std::move(body));
+        }
+    }
+
+    void accept()
+    {
+        while (!stopping)
+        {
+            const int connection = ::accept(listener, nullptr, nullptr);
+            if (connection < 0) continue;
+
+            int yes = 1;
+            ::setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+            std::lock_guard lock(mutex);
+            connections.push_back(connection);
+            workers.emplace_back([this, connection]() { serve(connection); });
+        }
+    }
+
+    void serve(int connection)
+    {
+        std::string buffer;
+        char chunk[4096];
+
+        while (true)
+        {
+            std::size_t end;
+            while ((end = buffer.find("\r\n\r\n")) == std::string::npos)
+            {
+                const auto n = ::recv(connection, chunk, sizeof(chunk), 0);
+                if (n <= 0) return drop(connection);
+                buffer.append(chunk, n);
+            }
+
+            const auto begin = threadCPU();
+
+            const auto line  = std::string_view(buffer).substr(0, buffer.find("\r\n"));
+            const auto first = line.find(' ');
+            const auto path  = line.substr(first + 1, line.rfind(' ') - first - 1);
+
+            std::string generated;
+            const std::string* body = respond(path, generated);
+            buffer.erase(0, end + 4);
+            requests++;
+
+            if (options.latency.count()) std::this_thread::sleep_for(options.latency);
+
+            std::string header = body
+                ? "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(body->size()) + "\r\n\r\n"
+                : "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+
+            const bool sent = send(connection, header) && (!body || send(connection, *body));
+            cpu_ns += threadCPU() - begin;
+
+            if (!sent) return drop(connection);
+        }
+    }
+
+    void drop(int connection)
+    {
+        std::lock_guard lock(mutex);
+        std::erase(connections, connection);
+        ::close(connection);
+    }
+
+    const std::string* respond(std::string_view path, std::string& generated) const
+    {
+        if (path.starts_with("/v1/tickers/"))
+        {
+            auto symbol = path.substr(12);
+            symbol = symbol.substr(0, symbol.find('?'));
+
+            generated = "{\"name\":\"" + std::string(symbol) + " Inc\",\"symbol\":\"" + std::string(symbol)
+                      + "\",\"stock_exchange\":{\"acronym\":\"MOCK\",\"city\":\"Nowhere\",\"country\":\"USA\"}}";
+            return &generated;
+        }
+
+        if (path.starts_with("/v1/intraday"))
+        {
+            std::size_t offset = 0;
+            const auto parameter = path.find("offset=");
+            if (parameter != std::string_view::npos)
+                std::from_chars(path.data() + parameter + 7, path.data() + path.size(), offset);
+
+            return &bodies[std::min(offset / options.page_size, bodies.size() - 1)];
+        }
+
+        return nullptr;
+    }
+
+    static bool send(int connection, const std::string& data)
+    {
+        std::size_t sent = 0;
+        while (sent < data.size())
+        {
+            const auto n = ::send(connection, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            sent += n;
+        }
+        return true;
+    }
+
+    static int64_t threadCPU()
+    {
+        timespec ts;
+        ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    Options options;
+    std::vector<std::string> bodies; // one per page offset
+
+    int listener = -1;
+    uint16_t port = 0;
+    std::atomic<bool> stopping = false;
+    std::atomic<int64_t> cpu_ns = 0;
+
+    std::mutex mutex;
+    std::vector<int> connections;
+    std::vector<std::thread> workers;
+    std::thread acceptor;
+};
@@ -0,0 +1,114 @@
+#include <sfl/data/Ingest.hpp>
+
+#include "MockServer.hpp"
+
+#include <filesystem>
+#include <sys/resource.h>
+
+using namespace sfl;
+
+/*
+
+sfl-bench-ingest [-t tickers] [-b bars] [-p page size] [-l latency ms] [-j concurrency] [-r repetitions] [-s]
+
+Ingests `tickers` synthetic tickers of `bars` bars each from an in-process
+mock server into DATABASE_DIR/2023.sft, through addCompanies (or one
+addCompany per ticker with -s). The server's own CPU time is subtracted
+from the process CPU time before it's divided by the bars ingested.
+
+*/
+
+static double processCPU()
+{
+    rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+         + static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+}
+
+int main(int argc, char** argv)
+{
+    MockServer::Options options;
+    std::size_t tickers = 50, concurrency = 8, repetitions = 3;
+    bool single = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if      (arg == "-t" && i + 1 < argc) tickers           = std::stoul(argv[++i]);
+        else if (arg == "-b" && i + 1 < argc) options.bars      = std::stoul(argv[++i]);
+        else if (arg == "-p" && i + 1 < argc) options.page_size = std::stoul(argv[++i]);
+        else if (arg == "-l" && i + 1 < argc) options.latency   = std::chrono::microseconds(std::stoul(argv[++i]) * 1000);
+        else if (arg == "-j" && i + 1 < argc) concurrency       = std::stoul(argv[++i]);
+        else if (arg == "-r" && i + 1 < argc) repetitions       = std::stoul(argv[++i]);
+        else if (arg == "-s") single = true;
+        else
+        {
+            std::cerr << "usage: sfl-bench-ingest [-t tickers] [-b bars] [-p page size] [-l latency ms] [-j concurrency] [-r repetitions] [-s]\n";
+            return 1;
+        }
+    }
+
+    MockServer server(options);
+    setAPIURL(server.url());
+    setAPIKey("bench");
+
+    std::vector<std::string> symbols;
+    for (std::size_t i = 0; i < tickers; i++)
+        symbols.push_back("M" + std::to_string(i));
+
+    const auto filename = detail::yearFilename(2023);
+    std::filesystem::create_directories(std::filesystem::path(filename).parent_path());
+
+    std::cout << tickers << " tickers x " << options.bars << " bars, " << options.page_size << " per page, "
+              << options.latency.count() / 1000 << "ms latency, "
+              << (single ? "addCompany" : "addCompanies -j " + std::to_string(concurrency)) << "\n\n";
+    std::printf("%4s %10s %12s %12s %12s\n", "rep", "seconds", "bars/s", "requests/s", "cpu us/bar");
+
+    double total_bars = 0, total_seconds = 0, total_requests = 0, total_cpu = 0;
+    for (std::size_t r = 0; r < repetitions; r++)
+    {
+        std::filesystem::remove(filename);
+        util::Universe::clear();
+
+        const auto requests   = server.requests.load();
+        const auto server_cpu = server.cpu();
+        const auto cpu        = processCPU();
+        const auto start      = std::chrono::steady_clock::now();
+
+        // every addCompany loads the year file again, into an empty universe
+        if (single)
+            for (const auto& s : symbols)
+            {
+                util::Universe::clear();
+                addCompany(s, 2023, concurrency);
+            }
+        else
+            addCompanies(symbols, 2023, concurrency);
+
+        const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const auto used    = (processCPU() - cpu) - (server.cpu() - server_cpu);
+        const auto served  = static_cast<double>(server.requests.load() - requests);
+
+        util::Universe::clear();
+        File file;
+        file.load(filename);
+
+        std::size_t bars = 0;
+        for (const auto& [company, points] : file.datapoints) bars += points.size();
+        util::Universe::clear();
+
+        std::printf("%4zu %10.3f %12.0f %12.0f %12.3f\n", r, seconds, bars / seconds, served / seconds, bars ? used / bars * 1e6 : 0.0);
+
+        total_bars     += bars;
+        total_seconds  += seconds;
+        total_requests += served;
+        total_cpu      += used;
+    }
+
+    std::printf("%4s %10.3f %12.0f %12.0f %12.3f\n", "all", total_seconds / repetitions,
+        total_bars / total_seconds, total_requests / total_seconds, total_bars ? total_cpu / total_bars * 1e6 : 0.0);
+
+    std::filesystem::remove(filename);
+    return 0;
+}
@@ -0,0 +1,339 @@
+#include <sfl/data/File.hpp>
+#include <sfl/run/Driver.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <random>
+
+#include <unistd.h>
+
+using namespace sfl;
+
+/*
+
+sfl_bench [-t tickers,...] [-b bars,...] [-f filter] [-m min seconds] [-o results.json]
+
+Times the hot paths of the library for every combination of ticker count and
+bars per ticker, on synthetic files written to the temporary directory. Each
+case is repeated until it has run for at least `min seconds` (and at least
+three times); the mean and fastest iteration are reported. Results are
+written as JSON to stdout or to the -o file, a table goes to stderr.
+
+*/
+
+// Keeps the compiler from dropping a computation whose result is never used
+template<typename T>
+static void keep(const T& value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+struct Result
+{
+    std::string name;
+    std::size_t tickers, bars;
+    std::size_t iterations;
+    double mean, fastest; // seconds per iteration
+    double items;         // processed per iteration
+};
+
+struct Bench
+{
+    std::vector<std::size_t> tickers = { 10, 100 };
+    std::vector<std::size_t> bars    = { 1000, 10000 };
+    std::string filter;
+    double min_time = 0.5;
+
+    std::vector<Result> results;
+
+    bool enabled(const std::string& name) const
+    {
+        return filter.empty() || name.find(filter) != std::string::npos;
+    }
+
+    // `setup` runs before every iteration and isn't timed
+    template<typename Setup, typename Body>
+    void measure(const std::string& name, std::size_t t, std::size_t b, double items, Setup&& setup, Body&& body)
+    {
+        using clock = std::chrono::steady_clock;
+
+        double total = 0, fastest = std::numeric_limits<double>::max();
+        std::size_t iterations = 0;
+        while (iterations < 3 || total < min_time)
+        {
+            setup();
+
+            const auto start = clock::now();
+            body();
+            const auto seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+            total  += seconds;
+            fastest = std::min(fastest, seconds);
+            iterations++;
+        }
+
+        results.push_back(Result{ name, t, b, iterations, total / iterations, fastest, items });
+        std::fprintf(stderr, "%-18s %6zu %8zu %10.3fms %10.3fms %14.0f/s\n",
+            name.c_str(), t, b, total / iterations * 1e3, fastest * 1e3, items * iterations / total);
+    }
+
+    template<typename Body>
+    void measure(const std::string& name, std::size_t t, std::size_t b, double items, Body&& body)
+    {
+        measure(name, t, b, items, []() {}, std::forward<Body>(body));
+    }
+
+    void json(std::ostream& out) const
+    {
+        out << "{\n  \"benchmarks\": [\n";
+        for (std::size_t i = 0; i < results.size(); i++)
+        {
+            const auto& r = results[i];
+            out << "    { \"name\": \"" << r.name << "\""
+                << ", \"tickers\": "          << r.tickers
+                << ", \"bars\": "             << r.bars
+                << ", \"iterations\": "       << r.iterations
+                << ", \"mean_seconds\": "     << r.mean
+                << ", \"fastest_seconds\": "  << r.fastest
+                << ", \"items_per_second\": " << r.items / r.mean
+                << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}\n";
+    }
+};
+
+/*
+
+Writes `tickers` companies of `bars` 30 minute bars each, every company
+skipping about 5% of the bars so Driver::run has to interpolate.
+
+*/
+static void
+writeDataset(const std::string& filename, std::size_t tickers, std::size_t bars)
+{
+    util::Universe::clear();
+
+    File file;
+    file.newExchange("BENCH");
+
+    std::vector<util::id_t> companies;
+    for (std::size_t c = 0; c < tickers; c++)
+        companies.push_back(file.newCompany("C" + std::to_string(c), "BENCH")->getID());
+
+    Writer writer(filename, file.exchanges, companies);
+
+    std::mt19937_64 random(tickers * 31 + bars);
+    std::normal_distribution<double> move(0.0, 0.002);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    Bars series;
+    series.reserve(bars);
+    for (std::size_t c = 0; c < tickers; c++)
+    {
+        series.clear();
+
+        double price = 100.0;
+        for (std::size_t i = 0; i < bars; i++)
+        {
+            const double open = price;
+            price *= std::exp(move(random));
+
+            // the first and last bar are always there, interpolation needs both neighbours
+            if (i != 0 && i + 1 != bars && uniform(random) < 0.05) continue;
+
+            series.push_back(1672617600 + i * 1800, open, std::max(open, price), std::min(open, price), price, price, 1000.0);
+        }
+
+        writer.write(series);
+    }
+
+    writer.close();
+    util::Universe::clear();
+}
+
+struct Idle : BaseStrategy
+{
+    void step() override {}
+};
+
+// Rebalances towards the best performing half of the universe every stop
+struct Momentum : BaseStrategy
+{
+    Momentum() : section(nullptr)
+    {
+        portfolio.cash = 1'000'000.0;
+    }
+
+    void step() override
+    {
+        if (row == 0) return;
+        if (!section) section = std::make_unique<CrossSection>(*panel);
+
+        const auto winners = section->top(section->returns(row), panel->width() / 2);
+        for (const auto column : winners)
+        {
+            const auto company = panel->companies[column];
+            if (portfolio.quantity(company) == 0) buy(company, 1);
+        }
+
+        for (const auto& [company, position] : portfolio.positions)
+            if (position.quantity > 0 && std::find_if(winners.begin(), winners.end(), [&](auto c) { return panel->companies[c] == company; }) == winners.end())
+                sell(company, position.quantity);
+    }
+
+    std::unique_ptr<CrossSection> section;
+};
+
+int main(int argc, char** argv)
+{
+    Bench bench;
+    std::string output;
+
+    const auto list = [](const std::string& arg)
+    {
+        std::vector<std::size_t> values;
+        std::stringstream ss(arg);
+        for (std::string v; std::getline(ss, v, ',');)
+            values.push_back(std::stoul(v));
+        return values;
+    };
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if      (arg == "-t" && i + 1 < argc) bench.tickers  = list(argv[++i]);
+        else if (arg == "-b" && i + 1 < argc) bench.bars     = list(argv[++i]);
+        else if (arg == "-f" && i + 1 < argc) bench.filter   = argv[++i];
+        else if (arg == "-m" && i + 1 < argc) bench.min_time = std::stod(argv[++i]);
+        else if (arg == "-o" && i + 1 < argc) output         = argv[++i];
+        else
+        {
+            std::cerr << "usage: sfl_bench [-t tickers,...] [-b bars,...] [-f filter] [-m min seconds] [-o results.json]\n";
+            return 1;
+        }
+    }
+
+    const auto directory = std::filesystem::temp_directory_path() / ("sfl_bench_" + std::to_string(::getpid()));
+    std::filesystem::create_directories(directory);
+
+    std::fprintf(stderr, "%-18s %6s %8s %12s %12s %16s\n", "benchmark", "ticker", "bars", "mean", "fastest", "throughput");
+
+    for (const auto t : bench.tickers)
+    for (const auto b : bench.bars)
+    {
+        const auto filename = (directory / "data.sft").string();
+        const auto copy     = (directory / "copy.sft").string();
+        const double points = static_cast<double>(t * b);
+
+        writeDataset(filename, t, b);
+
+        if (bench.enabled("file.load"))
+        {
+            std::optional<File> file;
+            bench.measure("file.load", t, b, points,
+                [&]() { file.reset(); util::Universe::clear(); file.emplace(); },
+                [&]() { file->load(filename); });
+            file.reset();
+        }
+
+        if (bench.enabled("file.write"))
+        {
+            util::Universe::clear();
+            File file;
+            file.load(filename);
+            bench.measure("file.write", t, b, points, [&]() { file.write(copy); });
+        }
+
+        if (bench.enabled("driver.align") || bench.enabled("driver.run") || bench.enabled("strategy.step"))
+        {
+            util::Universe::clear();
+            Driver<Idle> idle(filename);
+            idle.run();
+            const double stops = static_cast<double>(idle.curve().size());
+
+            // aligning the series on one timeline and interpolating the gaps, the first phase of run()
+            if (bench.enabled("driver.align"))
+            {
+                std::vector<util::id_t> companies;
+                bench.measure("driver.align", t, b, points, [&]() { keep(idle.align(companies)); });
+            }
+
+            // a whole run with a strategy that never trades: alignment, panel and the stop loop
+            if (bench.enabled("driver.run"))
+                bench.measure("driver.run", t, b, points, [&]() { idle.run(); });
+
+            // a whole run with a trading strategy, throughput is in stops; every run starts from
+            // a new driver, so from the starting cash and no positions
+            if (bench.enabled("strategy.step"))
+            {
+                std::optional<Driver<Momentum>> momentum;
+                bench.measure("strategy.step", t, b, stops,
+                    [&]() { momentum.reset(); util::Universe::clear(); momentum.emplace(filename); },
+                    [&]() { momentum->run(); });
+                if (!momentum->summary().trades)
+                    std::fprintf(stderr, "strategy.step: no trades, the case only measured an idle loop\n");
+                momentum.reset();
+            }
+        }
+
+        // the same run streamed a week at a time from the mapped file
+        if (bench.enabled("driver.sliced"))
+        {
+            util::Universe::clear();
+            Driver<Idle> idle(filename, Slices{ .seconds = 7 * 24 * 3600 });
+            bench.measure("driver.sliced", t, b, points, [&]() { idle.run(); });
+        }
+
+        if (bench.enabled("universe"))
+        {
+            util::Universe::clear();
+            const auto exchange = Exchange::makeNamed("BENCH");
+
+            std::vector<util::id_t> ids;
+            ids.reserve(t * b);
+
+            bench.measure("universe.make", t, b, points,
+                [&]() { ids.clear(); },
+                [&]()
+                {
+                    for (std::size_t i = 0; i < t * b; i++)
+                        ids.push_back(Datapoint::make(exchange->getID())->getID());
+                });
+
+            std::shuffle(ids.begin(), ids.end(), std::mt19937_64(t));
+
+            double sum = 0;
+            bench.measure("universe.get", t, b, points, [&]()
+            {
+                for (const auto id : ids)
+                    sum += static_cast<double>(Datapoint::get(id)->companyID());
+            });
+
+            std::vector<util::id_t> companies;
+            for (std::size_t c = 0; c < t; c++)
+                companies.push_back(Company::makeNamed("C" + std::to_string(c), exchange->getID())->getID());
+
+            std::size_t length = 0;
+            bench.measure("universe.getName", t, b, static_cast<double>(b), [&]()
+            {
+                for (std::size_t i = 0; i < b; i++)
+                    length += util::Universe::getName(companies[i % t]).size();
+            });
+
+            keep(sum);
+            keep(length);
+            util::Universe::clear();
+        }
+    }
+
+    std::filesystem::remove_all(directory);
+
+    if (output.empty()) bench.json(std::cout);
+    else
+    {
+        std::ofstream f(output);
+        bench.json(f);
+    }
+
+    return 0;
+}
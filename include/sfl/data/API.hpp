@@ -10,6 +10,9 @@
 #include <SL/Lua.hpp>
 
 #include "File.hpp"
+#include "Cache.hpp"
+
+#include <sfl/util/Time.hpp>
 
 #ifndef SOURCE_DIR
 #define SOURCE_DIR ""
@@ -25,10 +28,16 @@ namespace sfl
 namespace detail
 {
 
+inline std::optional<std::string>& apiKey()
+{
+    static std::optional<std::string> key;
+    return key;
+}
+
 static std::string
 getAPIKey()
 {
-    static std::optional<std::string> key;
+    auto& key = apiKey();
 
     if (!key)
     {
@@ -43,7 +52,7 @@ getAPIKey()
 }
 
 std::string
-getResponse(const std::string& url)
+curlResponse(const std::string& url)
 {
     using namespace curlpp::options;
 
@@ -66,159 +75,322 @@ getResponse(const std::string& url)
     return ss.str();
 }
 
+// Goes through the response cache first, then the installed transport (curlpp by default)
+std::string
+getResponse(const std::string& url)
+{
+    SFL_TRACE_SCOPE("http.get");
+
+    if (auto body = cached(url)) return std::move(*body);
 
+    if (offline())
+    {
+        std::cerr << ResponseCache::key(url) << ": not in the response cache\n";
+        return {};
+    }
 
+    auto body = transport() ? transport()(url) : curlResponse(url);
+    record(url, body);
+    return body;
 }
 
-nlohmann::json 
-getIntraday(
+// Base of every API url, can be pointed at a mirror or a local stand-in server
+inline std::string& apiURL()
+{
+    static std::string url = "https://api.marketstack.com";
+    return url;
+}
+
+std::string
+intradayURL(
     const std::string& ticker, 
     const std::string& interval, 
     const std::string& from_date, 
     const std::string& to_date,
     const std::string& offset)
 {
-    const auto url = [&]() -> std::string
-    {
-        std::stringstream ss;
-        ss << "https://api.marketstack.com/v1/intraday?access_key=";
-        ss << detail::getAPIKey();
-        ss << "&symbols="   << ticker;
-        ss << "&interval="  << interval;
-        ss << "&date_from=" << from_date;
-        ss << "&date_to="   << to_date;
-        ss << "&limit=1000";
-        ss << "&offset=" << offset;
-        return ss.str();
-    }();
-
-    return nlohmann::json::parse(detail::getResponse(url));
+    std::stringstream ss;
+    ss << apiURL() << "/v1/intraday?access_key=";
+    ss << detail::getAPIKey();
+    ss << "&symbols="   << ticker;
+    ss << "&interval="  << interval;
+    ss << "&date_from=" << from_date;
+    ss << "&date_to="   << to_date;
+    ss << "&limit=1000";
+    ss << "&offset=" << offset;
+    return ss.str();
 }
 
-nlohmann::json
-getCompany(
+std::string
+companyURL(
     const std::string& ticker)
 {
-    const auto url = [&]() -> std::string
+    std::stringstream ss;
+    ss << apiURL() << "/v1/tickers/";
+    ss << ticker;
+    ss << "?access_key=" << detail::getAPIKey();
+    return ss.str();
+}
+
+// Adds the exchange (if new) and the company described by a /v1/tickers response
+std::shared_ptr<Company>
+addCompany(File& file, const nlohmann::json& company)
+{
+    const auto exchange_name = company["stock_exchange"]["acronym"];
+    if (!util::Universe::exists(exchange_name))
     {
-        std::stringstream ss;
-        ss << "https://api.marketstack.com/v1/tickers/";
-        ss << ticker;
-        ss << "?access_key=" << detail::getAPIKey();
-        
-        return ss.str();
-    }();
+        auto exchange = file.newExchange(exchange_name);
+        exchange->city    = company["stock_exchange"]["city"];
+        exchange->country = company["stock_exchange"]["country"];
+    }
 
-    return nlohmann::json::parse(detail::getResponse(url));
+    return file.newCompany(company["name"], exchange_name, company["symbol"]);
 }
 
-void
-addCompany(
-    const std::string& ticker,
-    uint16_t year)
+/*
+
+SAX handler for /v1/intraday responses. Rows are decoded straight into bar
+columns as the parser walks the text, no DOM is built. Dates are ISO-8601
+with an explicit offset and are stored as UTC. A row is kept if it
+has a date and numeric open, high, low, close and last; a missing volume is
+stored as 0.
+
+*/
+struct PageReader : nlohmann::json_sax<nlohmann::json>
 {
-    File file;
-    const std::string filename = std::string(DATABASE_DIR) + "/" + std::to_string(static_cast<unsigned int>(year)) + ".sft";
+    Bars& bars;
+    uint32_t count = 0, total = 0;
+
+    PageReader(Bars& _bars) :
+        bars(_bars)
+    {   }
+
+    bool null() override { return value(std::nullopt); }
+    bool boolean(bool) override { return value(std::nullopt); }
+    bool number_integer(number_integer_t v) override { return number(static_cast<double>(v)); }
+    bool number_unsigned(number_unsigned_t v) override { return number(static_cast<double>(v)); }
+    bool number_float(number_float_t v, const string_t&) override { return number(v); }
+    bool binary(binary_t&) override { return value(std::nullopt); }
+
+    bool string(string_t& v) override
     {
-        std::ifstream f(
-            filename, 
-            std::ios_base::in | std::ios_base::binary
-        );
+        if (depth == 3 && in_data && field == Field::Date)
+        {
+            const auto t = parseISO8601(v);
+            if (t)
+            {
+                row.time = static_cast<std::size_t>(*t);
+                row.set |= bit(Field::Date);
+            }
+        }
+        field = Field::None;
+        return true;
+    }
 
-        f.close();
-        if (f) file.load(filename);
+    bool start_object(std::size_t) override
+    {
+        depth++;
+        if (depth == 3 && in_data) row = Row{};
+        return true;
     }
 
-    for (const auto& c : file.companies)
+    bool end_object() override
     {
-        auto d = Company::get(c);
-        if (d->ticker == ticker) return;
+        if (depth == 3 && in_data && (row.set & required()) == required())
+            bars.push_back(row.time, row.open, row.high, row.low, row.last, row.close, row.volume);
+
+        if (depth == 2) in_pagination = false;
+        depth--;
+        field = Field::None;
+        return true;
     }
 
-    const auto write_file = [&]()
+    bool start_array(std::size_t) override
     {
-        // Get company info
-        const auto company = getCompany(ticker);
+        depth++;
+        return true;
+    }
 
-        const auto exchange_name = company["stock_exchange"]["acronym"];
-        if (!util::Universe::exists(exchange_name))
+    bool end_array() override
+    {
+        if (depth == 2) in_data = false;
+        depth--;
+        field = Field::None;
+        return true;
+    }
+
+    bool key(string_t& k) override
+    {
+        field = Field::None;
+
+        if (depth == 1)
+        {
+            in_data       = (k == "data");
+            in_pagination = (k == "pagination");
+        }
+        else if (depth == 2 && in_pagination)
+        {
+            if      (k == "count") field = Field::Count;
+            else if (k == "total") field = Field::Total;
+        }
+        else if (depth == 3 && in_data)
         {
-            auto exchange = file.newExchange(exchange_name);
-            exchange->city    = company["stock_exchange"]["city"];
-            exchange->country = company["stock_exchange"]["country"];
+            if      (k == "open")   field = Field::Open;
+            else if (k == "high")   field = Field::High;
+            else if (k == "low")    field = Field::Low;
+            else if (k == "close")  field = Field::Close;
+            else if (k == "last")   field = Field::Last;
+            else if (k == "volume") field = Field::Volume;
+            else if (k == "date")   field = Field::Date;
         }
 
-        auto _company = file.newCompany(company["name"], exchange_name);
-        _company->ticker = company["symbol"];
+        return true;
+    }
 
-        const auto start_date = (std::stringstream() << year << "-01-01").str();
-        const auto end_date   = (std::stringstream() << year << "-12-31").str();
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& e) override
+    {
+        throw e;
+    }
 
-        uint32_t offset = 0;
-        bool done = false;
-        while (!done)
-        {
-            const auto page = getIntraday(
-                _company->ticker,
-                "30min",
-                start_date,
-                end_date,
-                std::to_string(offset)
-            );
+private:
+    enum class Field
+    {
+        None, Open, High, Low, Close, Last, Volume, Date, Count, Total
+    };
 
-            const auto& data = page["data"];
-            const auto retreived = page["pagination"]["count"].get<uint32_t>();
+    static constexpr uint32_t bit(Field f) { return 1u << static_cast<uint32_t>(f); }
 
-            if (retreived != 1000) done = true;
+    static constexpr uint32_t required()
+    {
+        return bit(Field::Open) | bit(Field::High) | bit(Field::Low) | bit(Field::Close) | bit(Field::Last) | bit(Field::Date);
+    }
+
+    struct Row
+    {
+        std::size_t time = 0;
+        double open = 0.0, high = 0.0, low = 0.0, close = 0.0, last = 0.0, volume = 0.0;
+        uint32_t set = 0;
+    };
 
-            for (uint32_t j = 0; j < retreived; j++)
+    bool number(double v)
+    {
+        if (depth == 3 && in_data)
+        {
+            switch (field)
             {
-                if (
-                    !data[j]["date"].is_string() ||
-                    !data[j]["open"].is_number() ||
-                    !data[j]["close"].is_number() ||
-                    !data[j]["high"].is_number() ||
-                    !data[j]["low"].is_number() ||
-                    !data[j]["last"].is_number() 
-                ) continue;
-
-                auto d = file.newDatapoint(_company->name);
-                d->open  = data[j]["open"].get<double>();
-                d->close = data[j]["close"].get<double>();
-                d->high  = data[j]["high"].get<double>();
-                d->low   = data[j]["low"].get<double>();
-                d->last  = data[j]["last"].get<double>();
-
-                const auto date = data[j]["date"].get<std::string>();
-                const auto year = std::stoi(date.substr(0, 4));
-                const auto month = std::stoi(date.substr(5, 2));
-                const auto day = std::stoi(date.substr(8, 2));
-                const auto hour = std::stoi(date.substr(11, 2));
-                const auto minute = std::stoi(date.substr(14, 2));
-                tm _tm{0};
-                _tm.tm_min = minute;
-                _tm.tm_hour = hour;
-                _tm.tm_mday = day;
-                _tm.tm_mon = month - 1;
-                _tm.tm_year = year - 1900;
-                time_t time = mktime(&_tm);
-                d->time = static_cast<std::size_t>(time);
+            case Field::Open:   row.open   = v; break;
+            case Field::High:   row.high   = v; break;
+            case Field::Low:    row.low    = v; break;
+            case Field::Close:  row.close  = v; break;
+            case Field::Last:   row.last   = v; break;
+            case Field::Volume: row.volume = v; break;
+            default: break;
             }
-
-            offset += retreived;
+            row.set |= bit(field);
+        }
+        else if (depth == 2 && in_pagination)
+        {
+            if      (field == Field::Count) count = static_cast<uint32_t>(v);
+            else if (field == Field::Total) total = static_cast<uint32_t>(v);
         }
 
-        file.write(filename);
-    };
-
-    try
-    {
-        write_file();
+        field = Field::None;
+        return true;
     }
-    catch(const std::exception& e)
+
+    bool value(std::optional<double>)
     {
-        std::cerr << e.what() << '\n';
+        field = Field::None;
+        return true;
     }
+
+    uint32_t depth = 0;
+    bool in_data = false, in_pagination = false;
+    Field field = Field::None;
+    Row row;
+};
+
+// Decodes a /v1/intraday page into the given columns (which are cleared first),
+// returns the amount of rows the page had
+uint32_t
+readPage(const std::string& body, Bars& bars)
+{
+    bars.clear();
+    PageReader reader(bars);
+    nlohmann::json::sax_parse(body, &reader);
+    return reader.count;
+}
+
+// Appends the bars of a /v1/intraday page later than `after`, returns the amount added
+std::size_t
+addPage(File& file, const std::string& company, const std::string& body, Bars& bars, std::size_t after = 0)
+{
+    readPage(body, bars);
+    return file.newDatapoints(company, bars, after);
+}
+
+std::string
+yearFilename(uint16_t year)
+{
+    return std::string(DATABASE_DIR) + "/" + std::to_string(static_cast<unsigned int>(year)) + ".sft";
+}
+
+// Loads the year file if it exists
+void
+loadYear(File& file, const std::string& filename)
+{
+    std::ifstream f(
+        filename, 
+        std::ios_base::in | std::ios_base::binary
+    );
+
+    f.close();
+    if (f) file.load(filename);
+}
+
+bool
+hasTicker(const File& file, const std::string& ticker)
+{
+    for (const auto& c : file.companies)
+        if (Company::get(c)->ticker == ticker) 
+            return true;
+    return false;
+}
+
+}
+
+// Points every request at another server, e.g. "http://127.0.0.1:8080"
+void
+setAPIURL(const std::string& url)
+{
+    detail::apiURL() = url;
 }
 
-}
\ No newline at end of file
+// Uses the given key instead of the one in config.lua
+void
+setAPIKey(const std::string& key)
+{
+    detail::apiKey() = key;
+}
+
+nlohmann::json 
+getIntraday(
+    const std::string& ticker, 
+    const std::string& interval, 
+    const std::string& from_date, 
+    const std::string& to_date,
+    const std::string& offset)
+{
+    const auto url = detail::intradayURL(ticker, interval, from_date, to_date, offset);
+    return nlohmann::json::parse(detail::getResponse(url));
+}
+
+nlohmann::json
+getCompany(
+    const std::string& ticker)
+{
+    const auto url = detail::companyURL(ticker);
+    return nlohmann::json::parse(detail::getResponse(url));
+}
+
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <sfl/def.hpp>
+#include <sfl/util/Time.hpp>
+
+#include "Price.hpp"
+
+namespace sfl
+{
+
+/*
+
+Column-wise bars for a single company. Used wherever bars are moved in bulk
+(decoding, importing, generating) so that no Datapoint has to exist until the
+bars land in a File.
+
+Values are held in the representation of the price policy P (see
+Price.hpp); push_back() takes doubles and encodes them.
+
+*/
+template<typename P = DoublePrice>
+struct BasicBars
+{
+    using price_type  = P;
+    using value_type  = typename P::value_type;
+    using volume_type = typename P::volume_type;
+
+    std::vector<value_type> open, high, low, last, close;
+    std::vector<volume_type> volume;
+    std::vector<std::size_t> time;
+
+    void reserve(std::size_t count)
+    {
+        open.reserve(count);
+        high.reserve(count);
+        low.reserve(count);
+        last.reserve(count);
+        close.reserve(count);
+        volume.reserve(count);
+        time.reserve(count);
+    }
+
+    void clear()
+    {
+        open.clear();
+        high.clear();
+        low.clear();
+        last.clear();
+        close.clear();
+        volume.clear();
+        time.clear();
+    }
+
+    void push_back(std::size_t t, double o, double h, double l, double la, double c, double v)
+    {
+        time.push_back(t);
+        open.push_back(P::encode(o));
+        high.push_back(P::encode(h));
+        low.push_back(P::encode(l));
+        last.push_back(P::encode(la));
+        close.push_back(P::encode(c));
+        volume.push_back(P::encodeVolume(v));
+    }
+
+    // The same bars in another representation
+    template<typename Q>
+    BasicBars<Q> as() const
+    {
+        BasicBars<Q> out;
+        out.reserve(size());
+        for (std::size_t i = 0; i < size(); i++)
+            out.push_back(time[i], P::decode(open[i]), P::decode(high[i]), P::decode(low[i]), P::decode(last[i]),
+                P::decode(close[i]), P::decodeVolume(volume[i]));
+        return out;
+    }
+
+    void append(const BasicBars& other)
+    {
+        open.insert(open.end(), other.open.begin(), other.open.end());
+        high.insert(high.end(), other.high.begin(), other.high.end());
+        low.insert(low.end(), other.low.begin(), other.low.end());
+        last.insert(last.end(), other.last.begin(), other.last.end());
+        close.insert(close.end(), other.close.begin(), other.close.end());
+        volume.insert(volume.end(), other.volume.begin(), other.volume.end());
+        time.insert(time.end(), other.time.begin(), other.time.end());
+    }
+
+    // Orders the bars by time, of bars sharing a time only the last one is kept
+    void sort()
+    {
+        if (std::is_sorted(time.begin(), time.end()) && 
+            std::adjacent_find(time.begin(), time.end()) == time.end())
+            return;
+
+        std::vector<uint32_t> order(size());
+        for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return time[a] < time[b]; });
+
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < order.size(); i++)
+        {
+            if (i + 1 < order.size() && time[order[i]] == time[order[i + 1]]) continue;
+            order[kept++] = order[i];
+        }
+        order.resize(kept);
+
+        const auto permute = [&](auto& column)
+        {
+            std::remove_reference_t<decltype(column)> sorted(order.size());
+            for (std::size_t i = 0; i < order.size(); i++)
+                sorted[i] = column[order[i]];
+            column = std::move(sorted);
+        };
+
+        permute(open);
+        permute(high);
+        permute(low);
+        permute(last);
+        permute(close);
+        permute(volume);
+        permute(time);
+    }
+
+    // Copies the bars with from <= time < to
+    BasicBars slice(std::size_t from, std::size_t to) const
+    {
+        const auto a = std::distance(time.begin(), std::lower_bound(time.begin(), time.end(), from));
+        const auto b = std::distance(time.begin(), std::lower_bound(time.begin(), time.end(), to));
+
+        BasicBars out;
+        out.open.assign(open.begin() + a, open.begin() + b);
+        out.high.assign(high.begin() + a, high.begin() + b);
+        out.low.assign(low.begin() + a, low.begin() + b);
+        out.last.assign(last.begin() + a, last.begin() + b);
+        out.close.assign(close.begin() + a, close.begin() + b);
+        out.volume.assign(volume.begin() + a, volume.begin() + b);
+        out.time.assign(time.begin() + a, time.begin() + b);
+        return out;
+    }
+
+    /*
+
+    Bars of `interval` seconds built from these (sorted) bars: first open,
+    highest high, lowest low, last last and close, summed volume. Each bar is
+    stamped with the start of its interval; intervals of whole weeks start on
+    Monday, everything else is aligned to the epoch.
+
+    */
+    BasicBars rollup(int64_t interval) const
+    {
+        constexpr int64_t week = 7 * 86400;
+        const int64_t origin = (interval % week == 0 ? 4 * 86400 : 0); // 1970-01-05 was a Monday
+
+        BasicBars out;
+        for (std::size_t i = 0; i < size(); i++)
+        {
+            const auto t = static_cast<int64_t>(time[i]);
+            const auto bucket = static_cast<std::size_t>(floorDiv(t - origin, interval) * interval + origin);
+
+            if (out.empty() || out.time.back() != bucket)
+            {
+                out.time.push_back(bucket);
+                out.open.push_back(open[i]);
+                out.high.push_back(high[i]);
+                out.low.push_back(low[i]);
+                out.last.push_back(last[i]);
+                out.close.push_back(close[i]);
+                out.volume.push_back(volume[i]);
+                continue;
+            }
+
+            out.high.back()    = std::max(out.high.back(), high[i]);
+            out.low.back()     = std::min(out.low.back(), low[i]);
+            out.last.back()    = last[i];
+            out.close.back()   = close[i];
+            out.volume.back() += volume[i];
+        }
+        return out;
+    }
+
+    std::size_t size() const { return time.size(); }
+    bool empty() const { return time.empty(); }
+};
+
+using Bars      = BasicBars<DoublePrice>;
+using FloatBars = BasicBars<FloatPrice>;
+using TickBars  = BasicBars<Ticks>;
+
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <sfl/def.hpp>
+
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string_view>
+
+namespace sfl
+{
+
+/*
+
+On-disk store of API responses. Entries are content-addressed by the request
+url with the access key removed, so a cache recorded with one key replays
+with any other, and nothing secret ends up on disk. Every entry is one file
+named after the 64-bit FNV-1a hash of that url; its first line holds the url
+itself so a hash collision is a miss rather than a wrong answer.
+
+Entries are written to a temporary file and renamed into place, a crashed
+run never leaves a truncated response behind.
+
+*/
+struct ResponseCache
+{
+    ResponseCache(const std::string& _directory) :
+        directory(_directory)
+    {
+        std::filesystem::create_directories(directory);
+    }
+
+    // The url without its access_key parameter
+    static std::string key(std::string_view url)
+    {
+        const auto query = url.find('?');
+        if (query == std::string_view::npos) return std::string(url);
+
+        std::string key(url.substr(0, query));
+        char separator = '?';
+
+        auto it = query + 1;
+        while (it <= url.size())
+        {
+            auto end = url.find('&', it);
+            if (end == std::string_view::npos) end = url.size();
+
+            const auto parameter = url.substr(it, end - it);
+            if (!parameter.empty() && !parameter.starts_with("access_key="))
+            {
+                key += separator;
+                key += parameter;
+                separator = '&';
+            }
+
+            it = end + 1;
+        }
+
+        return key;
+    }
+
+    std::filesystem::path path(const std::string& key) const
+    {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (const unsigned char c : key)
+        {
+            hash ^= c;
+            hash *= 0x100000001b3ull;
+        }
+
+        char name[17];
+        std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+        return directory / (std::string(name) + ".json");
+    }
+
+    std::optional<std::string> load(const std::string& url) const
+    {
+        const auto _key = key(url);
+
+        std::ifstream f(path(_key), std::ios_base::in | std::ios_base::binary);
+        if (!f) return std::nullopt;
+
+        std::string stored;
+        std::getline(f, stored);
+        if (stored != _key) return std::nullopt;
+
+        std::string body((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+        return body;
+    }
+
+    void store(const std::string& url, const std::string& body) const
+    {
+        const auto _key  = key(url);
+        const auto _path = path(_key);
+
+        auto temporary = _path;
+        temporary += ".tmp";
+
+        {
+            std::ofstream f(temporary, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+            if (!f) return;
+            f << _key << '\n';
+            f.write(body.data(), body.size());
+            if (!f) return;
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temporary, _path, error);
+    }
+
+private:
+    std::filesystem::path directory;
+};
+
+/*
+
+Off:    every request goes to the transport
+Record: responses are read from the cache, misses go to the transport and
+        successful responses are stored
+Replay: responses only come from the cache, a miss is an empty response;
+        nothing touches the network
+
+*/
+enum class CacheMode
+{
+    Off,
+    Record,
+    Replay
+};
+
+// Performs a GET and returns the body, an empty string on failure
+using Transport = std::function<std::string(const std::string& url)>;
+
+namespace detail
+{
+
+inline std::optional<ResponseCache>& responseCache()
+{
+    static std::optional<ResponseCache> cache;
+    return cache;
+}
+
+inline CacheMode& cacheMode()
+{
+    static CacheMode mode = CacheMode::Off;
+    return mode;
+}
+
+inline Transport& transport()
+{
+    static Transport transport;
+    return transport;
+}
+
+// The cached response to `url` if the current mode reads the cache
+inline std::optional<std::string> cached(const std::string& url)
+{
+    if (cacheMode() == CacheMode::Off || !responseCache()) return std::nullopt;
+    return responseCache()->load(url);
+}
+
+// Stores a response if the current mode records, API error objects are never stored
+inline void record(const std::string& url, const std::string& body)
+{
+    if (cacheMode() != CacheMode::Record || !responseCache()) return;
+    if (body.empty() || body.starts_with("{\"error\"")) return;
+
+    responseCache()->store(url, body);
+}
+
+inline bool offline()
+{
+    return cacheMode() == CacheMode::Replay;
+}
+
+} // namespace detail
+
+// Points every API request at a response cache in `directory`
+inline void setResponseCache(const std::string& directory, CacheMode mode = CacheMode::Record)
+{
+    detail::responseCache().emplace(directory);
+    detail::cacheMode() = mode;
+}
+
+inline void disableResponseCache()
+{
+    detail::responseCache().reset();
+    detail::cacheMode() = CacheMode::Off;
+}
+
+// Replaces the HTTP client used by single requests, an empty transport restores the default
+inline void setTransport(Transport transport)
+{
+    detail::transport() = std::move(transport);
+}
+
+}
@@ -1,8 +1,11 @@
 #pragma once
 
 #include <sfl/def.hpp>
+#include <sfl/util/Trace.hpp>
 
 #include "Objects.hpp"
+#include "Bars.hpp"
+#include "Schema.hpp"
 
 /*
 
@@ -12,6 +15,7 @@ The file type has the following structure:
 uint16_t    version    -- version of file
 std::size_t start_date -- first date
 std::size_t end_date   -- final date
+uint8_t     prices     -- PriceFormat of the records (version 3, double before)
 uint16_t    exchanges  -- amount of exchanges
 {
     uint16_t byte_size
@@ -36,12 +40,26 @@ uint32_t    companies  -- the amount of companies
 {
     std::size_t data_count;
     {
-        double open, high, low, last, close, volume;
+        value open, high, low, last, close, volume; -- double, float or int64_t ticks, see Price.hpp
         std::size_t time;
         index_type company;
-    } datapoints[data_count]
+    } datapoints[data_count]                -- BarSchema in Schema.hpp
 } data_sets[companies]
 
+<---- ROLLUPS (version 2) ---->
+{
+    data_sets[companies] -- same layout, bars of one coarser interval
+} rollup_sets[levels]
+
+uint16_t    levels     -- amount of rollup resolutions, may be 0
+{
+    int64_t     interval   -- seconds per bar
+    std::size_t offset     -- of the level's first data set
+} directory[levels]    -- by increasing interval
+std::size_t directory_offset -- last 8 bytes of the file, where `levels` is
+
+All numbers are little endian.
+
 */
 
 
@@ -53,7 +71,7 @@ namespace detail
 template<typename T>
 char* write_data(char* it, const T& val)
 {
-    std::memcpy(it, &val, sizeof(T));
+    schema::store<T>(it, val);
     it += sizeof(T);
     return it;
 }
@@ -72,7 +90,7 @@ T read_data(std::ifstream& file)
 {
     T v;
     file.read(reinterpret_cast<char*>(&v), sizeof(T));
-    return v;
+    return schema::little(v);
 }
 
 template<>
@@ -88,7 +106,7 @@ std::string read_data(std::ifstream& file)
 template<typename T>
 char* read_data(char* it, T& val)
 {
-    std::memcpy(&val, it, sizeof(T));
+    val = schema::load<T>(it);
     return it + sizeof(T);
 }
 
@@ -164,48 +182,343 @@ deCompany(std::ifstream& file, std::function<util::id_t(index_type)> get_exchang
     ticker   = read_data<std::string>(file);
     exchange = read_data<index_type>(file);
 
-    auto d = Company::makeNamed(name, get_exchange_id(exchange));
+    auto d = Company::makeNamed(companyKey(name, ticker), get_exchange_id(exchange));
     d->name   = name;
     d->ticker = ticker;
     return d;
 }
 
-std::pair<DataPointer, std::size_t> 
-serialize(const std::shared_ptr<Datapoint>& value, std::function<index_type(util::id_t)> get_company_index)
+} // namespace detail
+
+/*
+
+Streams a file straight from bar columns, without creating a Datapoint per
+bar. The exchange and company tables are written up front, then each call to
+write() appends the section of the next company in `companies` order. The
+date range in the header is filled in when the writer is closed.
+
+Every interval in `rollups` (seconds) gets its own rollup of each company's
+bars, spilled to a temporary file next to `filename` and copied after the
+raw sections on close, so the writer holds one company's bars at a time
+however large the file gets. Records are stored in `prices` representation,
+whatever the representation of the bars handed to write().
+
+*/
+struct Writer
 {
-    const std::size_t size = Datapoint::byte_size;
-    auto ptr = getRegion(size);
-    char* it = ptr.get();
-    std::memcpy(it, &value->open, sizeof(double) * 6);
-    it += sizeof(double) * 6;
-    it = write_data(it, value->time);
-    it = write_data(it, get_company_index(value->companyID()));
-    return std::pair(std::move(ptr), size);
-}
+    Writer(const std::string& _filename, std::vector<util::id_t> _exchanges, std::vector<util::id_t> _companies,
+        std::vector<int64_t> _rollups = {}, PriceFormat _prices = PriceFormat::Double) :
+        exchanges(std::move(_exchanges)),
+        companies(std::move(_companies)),
+        rollups(std::move(_rollups)),
+        prices(_prices),
+        filename(_filename),
+        f(_filename, std::ios_base::out | std::ios_base::binary)
+    {
+        using namespace detail;
+        assert(f);
+
+        std::sort(rollups.begin(), rollups.end());
+        rollups.erase(std::unique(rollups.begin(), rollups.end()), rollups.end());
+        rollups.erase(std::remove_if(rollups.begin(), rollups.end(), [](int64_t r) { return r <= 0; }), rollups.end());
+
+        levels.resize(rollups.size());
+        for (std::size_t l = 0; l < rollups.size(); l++)
+        {
+            levels[l].open(level(l), std::ios_base::in | std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+            assert(levels[l]);
+        }
+
+        const auto get_exchange_index = [&](util::id_t id)
+        {
+            const auto it = std::find(exchanges.begin(), exchanges.end(), id);
+            assert(it != exchanges.end());
+            return static_cast<index_type>(std::distance(exchanges.begin(), it));
+        };
+
+        write_value(static_cast<uint16_t>(FILE_VERSION));
+        write_value(smallest);
+        write_value(largest);
+        write_value(static_cast<uint8_t>(prices));
+
+        write_value(static_cast<uint16_t>(exchanges.size()));
+        for (const auto& id : exchanges)
+        {
+            auto data = serialize(Exchange::get(id));
+            write_value(static_cast<uint16_t>(data.second));
+            f.write(data.first.get(), data.second);
+        }
+
+        write_value(static_cast<uint16_t>(companies.size()));
+        for (const auto& id : companies)
+        {
+            auto data = serialize(Company::get(id), get_exchange_index);
+            write_value(static_cast<uint16_t>(data.second));
+            f.write(data.first.get(), data.second);
+        }
+    }
+
+    Writer(Writer&&) = delete;
+    Writer(const Writer&) = delete;
+
+    ~Writer()
+    {
+        close();
+    }
+
+    // Appends the next company's bars, which must be sorted by time
+    template<typename Q>
+    void write(const BasicBars<Q>& bars)
+    {
+        assert(written < companies.size());
+        const auto company = static_cast<index_type>(written++);
+
+        buffer.clear();
+        append(buffer, bars, company);
+        f.write(buffer.data(), buffer.size());
+
+        for (std::size_t l = 0; l < rollups.size(); l++)
+        {
+            buffer.clear();
+            append(buffer, bars.rollup(rollups[l]), company);
+            levels[l].write(buffer.data(), buffer.size());
+        }
 
-std::shared_ptr<Datapoint>
-deDatapoint(std::ifstream& file, std::function<util::id_t(index_type)> get_company_id)
+        if (!bars.empty())
+        {
+            smallest = std::min(smallest, bars.time.front());
+            largest  = std::max(largest, bars.time.back());
+        }
+    }
+
+    void close()
+    {
+        if (!f.is_open()) return;
+
+        // companies without a section still need their (empty) count
+        const Bars empty;
+        while (written < companies.size()) write(empty);
+
+        std::vector<std::size_t> offsets;
+        for (std::size_t l = 0; l < levels.size(); l++)
+        {
+            offsets.push_back(static_cast<std::size_t>(f.tellp()));
+
+            levels[l].seekg(0);
+            buffer.resize(1 << 20);
+            while (levels[l].read(buffer.data(), buffer.size()) || levels[l].gcount())
+                f.write(buffer.data(), levels[l].gcount());
+
+            levels[l].close();
+            std::remove(level(l).c_str());
+        }
+
+        const auto directory = static_cast<std::size_t>(f.tellp());
+        write_value(static_cast<uint16_t>(rollups.size()));
+        for (std::size_t l = 0; l < rollups.size(); l++)
+        {
+            write_value(rollups[l]);
+            write_value(offsets[l]);
+        }
+        write_value(directory);
+
+        f.seekp(sizeof(uint16_t));
+        write_value(smallest);
+        write_value(largest);
+        f.close();
+    }
+
+private:
+    // Temporary file of a rollup level
+    std::string level(std::size_t l) const
+    {
+        return filename + "." + std::to_string(rollups[l]) + ".rollup";
+    }
+
+    template<typename T>
+    void write_value(const T& value)
+    {
+        const T v = schema::little(value);
+        f.write(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+
+    // Encodes a data set: the count, then a record per bar
+    template<typename Q>
+    void append(std::vector<char>& out, const BasicBars<Q>& bars, index_type company) const
+    {
+        visitPrice(prices, [&](auto policy)
+        {
+            using P = decltype(policy);
+            using S = BarSchema<P>;
+
+            const auto begin = out.size();
+            out.resize(begin + sizeof(std::size_t) + bars.size() * S::record_size);
+            char* it = detail::write_data(out.data() + begin, static_cast<std::size_t>(bars.size()));
+
+            if constexpr (std::is_same_v<P, Q>)
+                S::encode(bars, 0, bars.size(), it, company);
+            else
+                S::encode(bars.template as<P>(), 0, bars.size(), it, company);
+        });
+    }
+
+    std::vector<util::id_t> exchanges, companies;
+    std::vector<int64_t> rollups;
+    PriceFormat prices;
+    std::string filename;
+    std::ofstream f;
+    std::vector<char> buffer;
+    std::vector<std::fstream> levels; // encoded rollup sets, by rollup
+    std::size_t written = 0;
+    std::size_t smallest = std::numeric_limits<std::size_t>::max();
+    std::size_t largest  = std::numeric_limits<std::size_t>::min();
+};
+
+namespace detail
 {
-    double double_data[6];
-    std::size_t time;
-    index_type company;
 
-    file.read(reinterpret_cast<char*>(double_data), sizeof(double) * 6);
-    time    = read_data<std::size_t>(file);
-    company = read_data<index_type>(file);
+struct RollupLevel
+{
+    int64_t     interval = 0;
+    std::size_t offset   = 0;
+};
 
-    auto d = Datapoint::make(get_company_id(company));
-    std::memcpy(&d->open, double_data, sizeof(double) * 6);
-    d->time = time;
-    return d;
+// Reads the rollup directory of a version 2 file, leaves the stream where it was
+inline std::vector<RollupLevel> readRollups(std::ifstream& f)
+{
+    const auto position = f.tellg();
+
+    f.seekg(-static_cast<std::streamoff>(sizeof(std::size_t)), std::ios_base::end);
+    f.seekg(static_cast<std::streamoff>(read_data<std::size_t>(f)));
+
+    std::vector<RollupLevel> levels(read_data<uint16_t>(f));
+    for (auto& l : levels)
+    {
+        l.interval = read_data<int64_t>(f);
+        l.offset   = read_data<std::size_t>(f);
+    }
+
+    f.seekg(position);
+    return f ? levels : std::vector<RollupLevel>();
 }
+
+// The coarsest level whose bars add up to bars of `interval` seconds
+inline const RollupLevel* coarsest(const std::vector<RollupLevel>& levels, int64_t interval)
+{
+    const RollupLevel* best = nullptr;
+    for (const auto& l : levels)
+        if (interval > 0 && interval % l.interval == 0 && (!best || l.interval > best->interval))
+            best = &l;
+    return best;
+}
+
 } // namespace detail
 
+/*
+
+Reads the exchange and company tables of a file and locates every company's
+section, without creating any objects or reading any bars. The first and
+last time of each section are read with two seeks, since sections are sorted.
+
+*/
+struct FileIndex
+{
+    struct ExchangeEntry
+    {
+        std::string name, country, city;
+    };
+
+    struct CompanyEntry
+    {
+        std::string name, ticker;
+        index_type  exchange;
+        std::size_t count  = 0;
+        std::size_t offset = 0; // of the first record
+        std::size_t first  = 0, last = 0;
+    };
+
+    uint16_t version = 0;
+    std::size_t start_date = 0, end_date = 0;
+    PriceFormat prices = PriceFormat::Double;
+    std::vector<ExchangeEntry> exchanges;
+    std::vector<CompanyEntry>  companies;
+    std::vector<detail::RollupLevel> rollups;
+
+    bool read(const std::string& filename)
+    {
+        using namespace detail;
+
+        std::ifstream f(filename, std::ios_base::in | std::ios_base::binary);
+        if (!f) return false;
+
+        version    = read_data<uint16_t>(f);
+        start_date = read_data<std::size_t>(f);
+        end_date   = read_data<std::size_t>(f);
+        prices     = (version >= 3 ? static_cast<PriceFormat>(read_data<uint8_t>(f)) : PriceFormat::Double);
+
+        exchanges.resize(read_data<uint16_t>(f));
+        for (auto& e : exchanges)
+        {
+            read_data<uint16_t>(f);
+            e.name    = read_data<std::string>(f);
+            e.country = read_data<std::string>(f);
+            e.city    = read_data<std::string>(f);
+        }
+
+        companies.resize(read_data<uint16_t>(f));
+        for (auto& c : companies)
+        {
+            read_data<uint16_t>(f);
+            c.name     = read_data<std::string>(f);
+            c.ticker   = read_data<std::string>(f);
+            c.exchange = read_data<index_type>(f);
+        }
+
+        const auto layout = recordLayout(prices);
+        for (auto& c : companies)
+        {
+            c.count  = read_data<std::size_t>(f);
+            c.offset = static_cast<std::size_t>(f.tellg());
+
+            if (c.count)
+            {
+                f.seekg(c.offset + layout.time_offset);
+                c.first = read_data<std::size_t>(f);
+                f.seekg(c.offset + (c.count - 1) * layout.record_size + layout.time_offset);
+                c.last = read_data<std::size_t>(f);
+            }
+
+            f.seekg(c.offset + c.count * layout.record_size);
+        }
+
+        if (version >= 2) rollups = readRollups(f);
+
+        return static_cast<bool>(f);
+    }
+
+    const CompanyEntry* find(const std::string& ticker) const
+    {
+        for (const auto& c : companies)
+            if (c.ticker == ticker)
+                return &c;
+        return nullptr;
+    }
+};
+
 struct File
 {
     std::vector<util::id_t> companies, exchanges;
     std::unordered_map<util::id_t, std::vector<util::id_t>> datapoints; // company_id, datapoint
 
+    // rollup intervals (seconds) written with the bars, load() keeps the ones the file had
+    std::vector<int64_t> rollups;
+
+    // interval of the loaded bars when they came from a rollup, 0 for the stored bars
+    int64_t resolution = 0;
+
+    // representation of the records on write, load() keeps the file's
+    PriceFormat prices = PriceFormat::Double;
+
     std::shared_ptr<Exchange>
     newExchange(const std::string& name)
     {
@@ -215,11 +528,13 @@ struct File
         return d;
     }
 
+    // Registered under companyKey(name, ticker), the name the other methods take
     std::shared_ptr<Company>
-    newCompany(const std::string& name, const std::string& exchange)
+    newCompany(const std::string& name, const std::string& exchange, const std::string& ticker = {})
     {
-        auto d = Company::makeNamed(name, util::Universe::getID(exchange));
-        d->name = name;
+        auto d = Company::makeNamed(companyKey(name, ticker), util::Universe::getID(exchange));
+        d->name   = name;
+        d->ticker = ticker;
         companies.push_back(d->getID());
         return d;
     }
@@ -233,18 +548,71 @@ struct File
         return d;
     }
 
-    void load(const std::string& filename)
+    // Adds the bars later than `after`, returns how many were added
+    template<typename Q>
+    std::size_t newDatapoints(const std::string& company, const BasicBars<Q>& bars, std::size_t after = 0)
+    {
+        return addDatapoints(util::Universe::getID(company), bars, after);
+    }
+
+    template<typename Q>
+    std::size_t addDatapoints(util::id_t company_id, const BasicBars<Q>& bars, std::size_t after = 0)
+    {
+        auto& points = datapoints[company_id];
+        points.reserve(points.size() + bars.size());
+
+        std::size_t added = 0;
+        for (std::size_t i = 0; i < bars.size(); i++)
+        {
+            if (after && bars.time[i] <= after) continue;
+
+            auto d = Datapoint::make(company_id);
+            d->open   = Q::decode(bars.open[i]);
+            d->high   = Q::decode(bars.high[i]);
+            d->low    = Q::decode(bars.low[i]);
+            d->last   = Q::decode(bars.last[i]);
+            d->close  = Q::decode(bars.close[i]);
+            d->volume = Q::decodeVolume(bars.volume[i]);
+            d->time   = bars.time[i];
+            points.push_back(d->getID());
+            added++;
+        }
+
+        return added;
+    }
+
+    // Bytes held by the id tables, the objects they refer to are accounted by the universe
+    std::size_t footprint() const
+    {
+        std::size_t bytes = (companies.capacity() + exchanges.capacity()) * sizeof(util::id_t);
+        bytes += datapoints.bucket_count() * sizeof(void*);
+        for (const auto& p : datapoints)
+            bytes += sizeof(void*) + sizeof(p) + p.second.capacity() * sizeof(util::id_t);
+        return bytes;
+    }
+
+    /*
+
+    Loads the file. With an `interval` (seconds) the bars come from the
+    coarsest stored rollup that divides it, so a daily backtest over a file
+    with 1h/1d/1w rollups reads only the daily bars; without a matching rollup
+    the stored bars are loaded.
+
+    */
+    void load(const std::string& filename, int64_t interval = 0)
     {
         using namespace detail;
+        SFL_TRACE_SCOPE("file.load");
 
         std::ifstream f(filename, std::ios_base::in | std::ios_base::binary);
         assert(f);
 
         const auto version = read_data<uint16_t>(f);
-        assert(version == FILE_VERSION);
+        assert(version >= 1 && version <= FILE_VERSION);
 
         read_data<std::size_t>(f); // smallest_date (maybe don't need)
         read_data<std::size_t>(f); // largest_date (maybe don't need)
+        prices = (version >= 3 ? static_cast<PriceFormat>(read_data<uint8_t>(f)) : PriceFormat::Double);
 
         const auto exchanges_size = read_data<uint16_t>(f);
         exchanges.reserve(exchanges_size);
@@ -263,25 +631,50 @@ struct File
         for (uint16_t i = 0; i < companies_size; i++)
             companies.push_back(deCompany(f, get_exchange_id)->getID());
         
-        const auto get_company_id =
-        [&](index_type index) -> util::id_t
+        rollups.clear();
+        resolution = 0;
+        if (version >= 2)
         {
-            assert(index < companies.size());
-            return companies[index];
-        };
+            const auto levels = readRollups(f);
+            for (const auto& l : levels)
+                rollups.push_back(l.interval);
 
-        for (uint16_t i = 0; i < companies_size; i++)
-        {
-            const auto count = read_data<std::size_t>(f);
-            datapoints[companies[i]].reserve(count);
-            for (std::size_t j = 0; j < count; j++)
-                datapoints[companies[i]].push_back(deDatapoint(f, get_company_id)->getID());
+            if (const auto* level = coarsest(levels, interval))
+            {
+                f.seekg(static_cast<std::streamoff>(level->offset));
+                resolution = level->interval;
+            }
         }
+
+        // a section is read in one go and decoded into columns, then into datapoints
+        visitPrice(prices, [&](auto policy)
+        {
+            using P = decltype(policy);
+            using S = BarSchema<P>;
+
+            std::vector<char> section;
+            BasicBars<P> bars;
+            for (uint16_t i = 0; i < companies_size; i++)
+            {
+                const auto count = read_data<std::size_t>(f);
+                section.resize(count * S::record_size);
+                f.read(section.data(), static_cast<std::streamsize>(section.size()));
+
+                S::decode(section.data(), count, bars);
+                addDatapoints(companies[i], bars);
+
+                SFL_TRACE_COUNTER("file.bars", count);
+            }
+        });
     }
 
     void write(const std::string& filename)
     {
         using namespace detail;
+        SFL_TRACE_SCOPE("file.write");
+
+        // rolled up bars would replace the stored ones
+        assert(resolution == 0);
 
         // sort companies and exchanges by name
         const auto pred = [](auto a, auto b) { return util::Universe::getName(a) < util::Universe::getName(b); };
@@ -289,23 +682,12 @@ struct File
         std::sort(exchanges.begin(), exchanges.end(), pred);
 
         // we want to sort data points by time as well as grab all the used names
-        auto smallest = std::numeric_limits<std::size_t>::max();
-        auto largest  = std::numeric_limits<std::size_t>::min();
         for (auto& p : datapoints)
         {
             std::sort(p.second.begin(), p.second.end(), [](auto a, auto b)
             {
                 return Datapoint::get(a)->time < Datapoint::get(b)->time;
             });
-
-            if (p.second.size())
-            {
-                auto first = Datapoint::get(p.second[0]);
-                auto last = Datapoint::get(p.second[p.second.size() - 1]);
-
-                if (first->time < smallest) smallest = first->time;
-                if (last->time > largest)   largest  = last->time;
-            }
         }
 
         std::vector<util::id_t> used_exchanges;
@@ -322,78 +704,31 @@ struct File
 
             if ([&]()
             {
-                const auto it = std::find(exchanges.begin(), exchanges.end(), Company::get(c)->exchangeID());
-                return (it != exchanges.end());
+                const auto exchange = Company::get(c)->exchangeID();
+                const auto it = std::find(exchanges.begin(), exchanges.end(), exchange);
+                return (it != exchanges.end() && 
+                    std::find(used_exchanges.begin(), used_exchanges.end(), exchange) == used_exchanges.end());
             }()) used_exchanges.push_back(Company::get(c)->exchangeID());
         }
 
-        const auto get_company_index = [&](util::id_t id)
-        {
-            const auto it = std::find(used_companies.begin(), used_companies.end(), id);
-            assert(it != used_companies.end());
-            return std::distance(used_companies.begin(), it);
-        };
-
-        const auto get_exchange_index = [&](util::id_t id)
-        {
-            const auto it = std::find(used_exchanges.begin(), used_exchanges.end(), id);
-            assert(it != used_exchanges.end());
-            return std::distance(used_exchanges.begin(), it);
-        };
-
-        // write all the data to the file
-        std::ofstream f(filename, std::ios_base::out | std::ios_base::binary);
-        assert(f);
-
-        write_value(f, static_cast<uint16_t>(FILE_VERSION));
-        write_value(f, smallest);
-        write_value(f, largest);
-
-        write_value(f, static_cast<uint16_t>(used_exchanges.size()));
-        for (const auto& id : used_exchanges)
-        {
-            auto data = serialize(Exchange::get(id));
-            write_value(f, static_cast<uint16_t>(data.second));
-            f.write(data.first.get(), data.second);
-        }
-
-        std::size_t total_byte_size = 0;
-        write_value(f, static_cast<uint16_t>(used_companies.size()));
-        for (const auto& id : used_companies)
-        {
-            auto data = serialize(Company::get(id), get_exchange_index);
-            write_value(f, static_cast<uint16_t>(data.second));
-            f.write(data.first.get(), data.second);
+        // write all the data to the file, one company at a time
+        Writer writer(filename, used_exchanges, used_companies, rollups, prices);
 
-            total_byte_size += datapoints[id].size() * Datapoint::byte_size;
-        }
-
-        uint32_t it = 0;
-        std::vector<char> total_data(total_byte_size + sizeof(std::size_t) * datapoints.size());
+        Bars bars;
         for (const auto& c : used_companies)
         {
             const auto& points = datapoints[c];
-            
-            std::size_t count = points.size();
-            std::memcpy(&total_data[it], &count, sizeof(std::size_t));
-            it += sizeof(std::size_t);
 
+            bars.clear();
+            bars.reserve(points.size());
             for (const auto& p : points)
             {
-                auto data = serialize(Datapoint::get(p), get_company_index);
-                std::memcpy(&total_data[it], data.first.get(), data.second);
-                it += data.second;
+                const auto d = Datapoint::get(p);
+                bars.push_back(d->time, d->open, d->high, d->low, d->last, d->close, d->volume);
             }
-        }
 
-        f.write(total_data.data(), total_data.size());
-    }
-
-private:
-    template<typename T>
-    void write_value(std::ofstream& f, const T& value)
-    {
-        f.write(reinterpret_cast<const char*>(&value), sizeof(T));
+            writer.write(bars);
+        }
     }
 };
 
@@ -0,0 +1,476 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <map>
+
+#include <sfl/def.hpp>
+#include <sfl/util/MappedFile.hpp>
+#include <sfl/util/Time.hpp>
+
+#include "File.hpp"
+
+namespace sfl
+{
+
+struct ImportOptions
+{
+    std::size_t threads  = std::max(1u, std::thread::hardware_concurrency());
+    std::string exchange = "UNKNOWN"; // used when the file has no exchange column
+    char        delimiter = ',';
+    std::vector<int64_t> rollups; // intervals (seconds) stored alongside the bars, see Writer
+    PriceFormat prices = PriceFormat::Double; // of the records
+    std::size_t block  = std::size_t(256) << 20; // bytes of CSV parsed at once, across the threads
+};
+
+namespace detail
+{
+
+/*
+
+Column positions found in a CSV header. Names are matched case-insensitively:
+ticker/symbol, timestamp/datetime/date (+ an optional separate time),
+open, high, low, close, last, volume, exchange and name. Only the ticker,
+the time and open/high/low/close are required, a missing last is the close.
+
+*/
+struct CSVLayout
+{
+    int ticker = -1, date = -1, time = -1;
+    int open = -1, high = -1, low = -1, close = -1, last = -1, volume = -1;
+    int exchange = -1, name = -1;
+
+    bool valid() const
+    {
+        return ticker >= 0 && date >= 0 && open >= 0 && high >= 0 && low >= 0 && close >= 0;
+    }
+};
+
+template<typename F>
+void splitFields(std::string_view line, char delimiter, F&& field)
+{
+    int index = 0;
+    std::size_t start = 0;
+    while (start <= line.size())
+    {
+        auto end = line.find(delimiter, start);
+        if (end == std::string_view::npos) end = line.size();
+
+        auto f = line.substr(start, end - start);
+        if (f.size() >= 2 && f.front() == '"' && f.back() == '"') f = f.substr(1, f.size() - 2);
+        field(index++, f);
+
+        start = end + 1;
+    }
+}
+
+inline CSVLayout readLayout(std::string_view header, char delimiter)
+{
+    CSVLayout layout;
+    splitFields(header, delimiter, [&](int i, std::string_view f)
+    {
+        std::string name(f);
+        for (auto& c : name) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        while (!name.empty() && (name.back() == '\r' || name.back() == ' ')) name.pop_back();
+
+        if      (name == "ticker" || name == "symbol") layout.ticker = i;
+        else if (name == "timestamp" || name == "datetime" || name == "date")
+        {
+            if (layout.date < 0 || name != "date") layout.date = i;
+        }
+        else if (name == "time")     layout.time = i;
+        else if (name == "open")     layout.open = i;
+        else if (name == "high")     layout.high = i;
+        else if (name == "low")      layout.low = i;
+        else if (name == "close")    layout.close = i;
+        else if (name == "last")     layout.last = i;
+        else if (name == "volume")   layout.volume = i;
+        else if (name == "exchange") layout.exchange = i;
+        else if (name == "name")     layout.name = i;
+    });
+
+    // a lone "time" column holds the whole timestamp
+    if (layout.date < 0 && layout.time >= 0) std::swap(layout.date, layout.time);
+    return layout;
+}
+
+// Epoch seconds (or milliseconds) or an ISO-8601 date/time
+inline std::optional<int64_t> parseTimestamp(std::string_view date, std::string_view time)
+{
+    if (!date.empty() && std::all_of(date.begin(), date.end(), [](char c) { return c >= '0' && c <= '9'; }))
+    {
+        int64_t v = 0;
+        std::from_chars(date.data(), date.data() + date.size(), v);
+        return (v > 100000000000 ? v / 1000 : v);
+    }
+
+    if (time.empty()) return parseISO8601(date);
+
+    char buffer[64];
+    if (date.size() + time.size() + 1 > sizeof(buffer)) return std::nullopt;
+    std::memcpy(buffer, date.data(), date.size());
+    buffer[date.size()] = 'T';
+    std::memcpy(buffer + date.size() + 1, time.data(), time.size());
+    return parseISO8601(std::string_view(buffer, date.size() + time.size() + 1));
+}
+
+struct ImportChunk
+{
+    std::unordered_map<std::string, Bars> tickers;
+    std::unordered_map<std::string, std::pair<std::string, std::string>> descriptions; // ticker, (exchange, name)
+    std::size_t rejected = 0;
+};
+
+// Parses whole lines of a CSV body into per-ticker bars
+inline void parseChunk(std::string_view text, const CSVLayout& layout, char delimiter, ImportChunk& chunk)
+{
+    std::string_view fields[32];
+    const int max_field = std::max({ layout.ticker, layout.date, layout.time, layout.open, layout.high, layout.low,
+        layout.close, layout.last, layout.volume, layout.exchange, layout.name });
+    assert(max_field < 32);
+
+    // rows of one ticker usually come together, so remember the last one
+    std::string_view current;
+    Bars* bars = nullptr;
+
+    const auto number = [&](int index, double fallback, bool& ok)
+    {
+        if (index < 0) return fallback;
+        const auto f = fields[index];
+        double v = 0.0;
+        const auto result = std::from_chars(f.data(), f.data() + f.size(), v);
+        if (result.ec != std::errc()) ok = false;
+        return v;
+    };
+
+    std::size_t start = 0;
+    while (start < text.size())
+    {
+        auto end = text.find('\n', start);
+        if (end == std::string_view::npos) end = text.size();
+
+        auto line = text.substr(start, end - start);
+        start = end + 1;
+
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (line.empty()) continue;
+
+        int count = 0;
+        splitFields(line, delimiter, [&](int i, std::string_view f)
+        {
+            if (i < 32) fields[i] = f;
+            count = i + 1;
+        });
+
+        if (count <= max_field)
+        {
+            chunk.rejected++;
+            continue;
+        }
+
+        bool ok = true;
+        const auto close = number(layout.close, 0.0, ok);
+        const auto open  = number(layout.open, 0.0, ok);
+        const auto high  = number(layout.high, 0.0, ok);
+        const auto low   = number(layout.low, 0.0, ok);
+        const auto last  = number(layout.last, close, ok);
+
+        bool volume_ok = true;
+        auto volume = number(layout.volume, 0.0, volume_ok);
+        if (!volume_ok) volume = 0.0;
+
+        const auto t = parseTimestamp(fields[layout.date], (layout.time >= 0 ? fields[layout.time] : std::string_view()));
+        if (!ok || !t)
+        {
+            chunk.rejected++;
+            continue;
+        }
+
+        const auto ticker = fields[layout.ticker];
+        if (!bars || ticker != current)
+        {
+            auto it = chunk.tickers.find(std::string(ticker));
+            if (it == chunk.tickers.end())
+            {
+                it = chunk.tickers.emplace(std::string(ticker), Bars{}).first;
+                chunk.descriptions[it->first] = std::pair(
+                    (layout.exchange >= 0 ? std::string(fields[layout.exchange]) : std::string()),
+                    (layout.name >= 0 ? std::string(fields[layout.name]) : std::string()));
+            }
+
+            bars = &it->second;
+            current = ticker;
+        }
+
+        bars->push_back(static_cast<std::size_t>(*t), open, high, low, last, close, volume);
+    }
+}
+
+// A bar spilled to disk during an import, tagged with the index of its ticker
+using SpillSchema = schema::Schema<
+    schema::Column<&Bars::open>,
+    schema::Column<&Bars::high>,
+    schema::Column<&Bars::low>,
+    schema::Column<&Bars::last>,
+    schema::Column<&Bars::close>,
+    schema::Column<&Bars::volume>,
+    schema::Column<&Bars::time>,
+    schema::Constant<uint32_t>>;
+
+constexpr std::size_t spill_ticker = 7;
+
+} // namespace detail
+
+struct ImportResult
+{
+    std::size_t rows = 0, rejected = 0, tickers = 0;
+    std::vector<std::string> files;
+};
+
+/*
+
+Imports vendor CSV bar dumps into one .sft file per year in `directory`
+(<year>.sft, the same layout addCompany uses). Every input is memory mapped
+and read `options.block` bytes at a time, split at line boundaries into one
+chunk per thread; the chunks are parsed in parallel and their bars spilled,
+in file order, to a temporary run per year in `directory`. Each year's run
+is then scattered into one region per ticker on disk, and every region is
+sorted and written in turn, so memory holds one block of CSV or the bars of
+one ticker in one year, never the whole input. There is one company per
+ticker, named after the name column if there is one, the ticker otherwise.
+
+*/
+inline ImportResult
+importCSV(
+    const std::vector<std::string>& inputs,
+    const std::string& directory,
+    const ImportOptions& options = {})
+{
+    using namespace detail;
+    using Spill = SpillSchema;
+
+    ImportResult result;
+
+    // tickers in order of appearance, with their (exchange, name)
+    std::unordered_map<std::string, uint32_t> index;
+    std::vector<std::string> tickers;
+    std::vector<std::pair<std::string, std::string>> descriptions;
+
+    // a run of spilled bars per year, with the number of bars of every ticker in it
+    struct Run
+    {
+        std::ofstream file;
+        std::vector<std::size_t> counts;
+        std::size_t bars = 0;
+    };
+    std::map<int32_t, Run> runs; // ordered, so the output is deterministic
+
+    const auto temporary = [&](int32_t year, const char* kind)
+    {
+        return directory + "/." + std::to_string(year) + "." + kind;
+    };
+
+    std::vector<char> buffer;
+    const auto spill = [&](uint32_t ticker, const Bars& bars)
+    {
+        // rows mostly come in time order, so bars of a year come in long stretches
+        for (std::size_t begin = 0, end = 0; begin < bars.size(); begin = end)
+        {
+            const auto year = civilFromDays(floorDiv(static_cast<int64_t>(bars.time[begin]), 86400)).year;
+            const auto from = static_cast<std::size_t>(daysFromCivil(year, 1, 1) * 86400);
+            const auto to   = static_cast<std::size_t>(daysFromCivil(year + 1, 1, 1) * 86400);
+            for (end = begin + 1; end < bars.size() && bars.time[end] >= from && bars.time[end] < to; end++);
+
+            auto& run = runs[year];
+            if (!run.file.is_open())
+                run.file.open(temporary(year, "spill"), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+            if (run.counts.size() <= ticker) run.counts.resize(ticker + 1);
+            run.counts[ticker] += end - begin;
+            run.bars += end - begin;
+
+            buffer.resize((end - begin) * Spill::record_size);
+            Spill::encode(bars, begin, end - begin, buffer.data(), ticker);
+            run.file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        }
+    };
+
+    const auto threads = std::max<std::size_t>(options.threads, 1);
+    const auto piece   = std::max<std::size_t>(options.block / threads, 1 << 16);
+
+    for (const auto& input : inputs)
+    {
+        util::MappedFile file(input);
+        if (!file)
+        {
+            std::cerr << input << ": could not open\n";
+            continue;
+        }
+
+        const auto text = file.view();
+        const auto header_end = text.find('\n');
+        if (header_end == std::string_view::npos) continue;
+
+        const auto layout = readLayout(text.substr(0, header_end), options.delimiter);
+        if (!layout.valid())
+        {
+            std::cerr << input << ": header needs ticker, date, open, high, low and close columns\n";
+            continue;
+        }
+
+        const auto body = text.substr(header_end + 1);
+        for (std::size_t start = 0; start < body.size(); )
+        {
+            // the next block, one piece per thread, each ending on a line break
+            std::vector<std::string_view> pieces;
+            for (std::size_t i = 0; i < threads && start < body.size(); i++)
+            {
+                auto end = (start + piece >= body.size() ? std::string_view::npos : body.find('\n', start + piece));
+                end = (end == std::string_view::npos ? body.size() : end + 1);
+                pieces.push_back(body.substr(start, end - start));
+                start = end;
+            }
+
+            std::vector<ImportChunk> chunks(pieces.size());
+            if (pieces.size() == 1) parseChunk(pieces[0], layout, options.delimiter, chunks[0]);
+            else
+            {
+                std::vector<std::thread> workers;
+                for (std::size_t i = 0; i < pieces.size(); i++)
+                    workers.emplace_back([&, i]() { parseChunk(pieces[i], layout, options.delimiter, chunks[i]); });
+                for (auto& w : workers) w.join();
+            }
+
+            for (auto& chunk : chunks)
+            {
+                result.rejected += chunk.rejected;
+                for (const auto& p : chunk.tickers)
+                {
+                    const auto [it, added] = index.try_emplace(p.first, static_cast<uint32_t>(tickers.size()));
+                    if (added)
+                    {
+                        tickers.push_back(p.first);
+                        descriptions.push_back(chunk.descriptions[p.first]);
+                    }
+
+                    result.rows += p.second.size();
+                    spill(it->second, p.second);
+                }
+            }
+        }
+    }
+
+    result.tickers = tickers.size();
+
+    // make the exchanges and companies, keyed by ticker since share classes (GOOG, GOOGL) have the same issuer name
+    std::vector<util::id_t> ids;
+    for (std::size_t t = 0; t < tickers.size(); t++)
+    {
+        const auto& description = descriptions[t];
+        const auto exchange_name = (description.first.empty() ? options.exchange : description.first);
+        const auto name = (description.second.empty() ? tickers[t] : description.second);
+
+        if (!util::Universe::exists(exchange_name))
+            Exchange::makeNamed(exchange_name)->name = exchange_name;
+
+        const auto company = (util::Universe::exists(tickers[t])
+            ? Company::get(tickers[t])
+            : Company::makeNamed(tickers[t], util::Universe::getID(exchange_name)));
+        company->name   = name;
+        company->ticker = tickers[t];
+        ids.push_back(company->getID());
+    }
+
+    for (auto& [year, run] : runs)
+    {
+        run.file.close();
+        run.counts.resize(tickers.size());
+
+        // the year's tickers in file order
+        std::vector<uint32_t> order;
+        for (uint32_t t = 0; t < tickers.size(); t++)
+            if (run.counts[t]) order.push_back(t);
+
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+        {
+            const auto& x = *Company::get(ids[a]);
+            const auto& y = *Company::get(ids[b]);
+            return (x.name != y.name ? x.name < y.name : x.ticker < y.ticker);
+        });
+
+        std::vector<std::size_t> offsets(tickers.size(), 0);
+        std::size_t offset = 0;
+        for (const auto t : order)
+        {
+            offsets[t] = offset;
+            offset += run.counts[t];
+        }
+
+        // scatter the run into a region per ticker, through a small buffer per ticker
+        {
+            constexpr std::size_t batch = 64;
+
+            util::MappedFile spilled(temporary(year, "spill"));
+            std::ofstream scattered(temporary(year, "sorted"), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+
+            std::vector<std::vector<char>> pending(tickers.size());
+            std::vector<std::size_t> placed(tickers.size(), 0);
+            const auto flush = [&](uint32_t t)
+            {
+                scattered.seekp(static_cast<std::streamoff>((offsets[t] + placed[t]) * Spill::record_size));
+                scattered.write(pending[t].data(), static_cast<std::streamsize>(pending[t].size()));
+                placed[t] += pending[t].size() / Spill::record_size;
+                pending[t].clear();
+            };
+
+            const char* records = spilled.view().data();
+            for (std::size_t i = 0; i < run.bars; i++)
+            {
+                const char* record = records + i * Spill::record_size;
+                const auto t = Spill::template read<spill_ticker>(record);
+
+                auto& p = pending[t];
+                p.insert(p.end(), record, record + Spill::record_size);
+                if (p.size() == batch * Spill::record_size) flush(t);
+            }
+
+            for (const auto t : order)
+                if (!pending[t].empty()) flush(t);
+        }
+        std::filesystem::remove(temporary(year, "spill"));
+
+        std::vector<util::id_t> companies, exchanges;
+        for (const auto t : order)
+        {
+            companies.push_back(ids[t]);
+            const auto exchange = Company::get(ids[t])->exchangeID();
+            if (std::find(exchanges.begin(), exchanges.end(), exchange) == exchanges.end())
+                exchanges.push_back(exchange);
+        }
+
+        const auto filename = directory + "/" + std::to_string(year) + ".sft";
+        {
+            Writer writer(filename, exchanges, companies, options.rollups, options.prices);
+
+            util::MappedFile scattered(temporary(year, "sorted"));
+            const char* records = scattered.view().data();
+
+            Bars bars;
+            for (const auto t : order)
+            {
+                Spill::decode(records + offsets[t] * Spill::record_size, run.counts[t], bars);
+                bars.sort();
+                writer.write(bars);
+            }
+        }
+        std::filesystem::remove(temporary(year, "sorted"));
+
+        result.files.push_back(filename);
+    }
+
+    return result;
+}
+
+}
@@ -0,0 +1,716 @@
+#pragma once
+
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <charconv>
+#include <chrono>
+#include <map>
+#include <unordered_set>
+
+#include <curl/curl.h>
+
+#include "API.hpp"
+
+namespace sfl
+{
+
+/*
+
+Runs many HTTP GETs concurrently over a single curl multi handle. Easy
+handles are recycled between requests, so connections to the same host stay
+alive in the multi handle's connection cache instead of being renegotiated
+for every page. At most `concurrency` transfers are in flight; everything
+else waits in a FIFO queue.
+
+Callbacks run on the thread that calls run(), one at a time, and may queue
+further requests. Requests found in the response cache complete without
+touching the network, and successful responses are recorded into it.
+
+Transfer errors, 429 and 5xx responses are retried up to `retries` times,
+waiting `backoff` before the first retry and twice as long before every
+next one. Any other status outside 2xx, or a request out of retries, calls
+its failure callback instead of its callback.
+
+*/
+struct Ingest
+{
+    using Callback = std::function<void(std::string&&)>;
+    using Failure  = std::function<void(const std::string&)>; // error message
+
+    Ingest(std::size_t _concurrency = 8, long _timeout = 60, std::size_t _retries = 3,
+           std::chrono::milliseconds _backoff = std::chrono::milliseconds(500)) :
+        concurrency(std::max<std::size_t>(_concurrency, 1)),
+        timeout(_timeout),
+        retries(_retries),
+        backoff(_backoff)
+    {
+        static const auto init = curl_global_init(CURL_GLOBAL_DEFAULT);
+        (void)init;
+
+        multi = curl_multi_init();
+        assert(multi);
+
+        curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, static_cast<long>(concurrency));
+        curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(concurrency));
+    }
+
+    Ingest(Ingest&&) = delete;
+    Ingest(const Ingest&) = delete;
+
+    ~Ingest()
+    {
+        for (auto& t : transfers)
+            if (t->request.callback)
+                curl_multi_remove_handle(multi, t->handle);
+
+        for (auto& t : transfers)
+            curl_easy_cleanup(t->handle);
+
+        curl_multi_cleanup(multi);
+    }
+
+    void get(const std::string& url, Callback callback, Failure failure = nullptr)
+    {
+        if (auto body = detail::cached(url))
+            ready.push_back(std::pair(std::move(*body), std::move(callback)));
+        else if (detail::offline())
+            fail(failure, ResponseCache::key(url) + ": not in the response cache");
+        else
+            queued.push_back(Request{ url, std::move(callback), std::move(failure) });
+    }
+
+    std::size_t pending() const { return ready.size() + queued.size() + delayed.size() + active; }
+
+    // Drives every queued (and subsequently queued) request to completion
+    void run()
+    {
+        while (pending())
+        {
+            while (!ready.empty())
+            {
+                auto response = std::move(ready.front());
+                ready.pop_front();
+                deliver(response.second, std::move(response.first));
+            }
+
+            // retries whose backoff is over go to the back of the queue
+            const auto now = clock::now();
+            while (!delayed.empty() && delayed.begin()->first <= now)
+            {
+                queued.push_back(std::move(delayed.begin()->second));
+                delayed.erase(delayed.begin());
+            }
+
+            while (active < concurrency && !queued.empty())
+            {
+                auto request = std::move(queued.front());
+                queued.pop_front();
+                start(std::move(request));
+            }
+
+            int running = 0;
+            curl_multi_perform(multi, &running);
+
+            int messages = 0;
+            while (CURLMsg* msg = curl_multi_info_read(multi, &messages))
+            {
+                if (msg->msg != CURLMSG_DONE) continue;
+                finish(msg->easy_handle, msg->data.result);
+            }
+
+            if (active || (ready.empty() && queued.empty() && !delayed.empty()))
+            {
+                auto wait = std::chrono::milliseconds(100);
+                if (!delayed.empty())
+                    wait = std::clamp(std::chrono::ceil<std::chrono::milliseconds>(delayed.begin()->first - clock::now()),
+                        std::chrono::milliseconds(0), wait);
+                curl_multi_poll(multi, nullptr, 0, static_cast<int>(wait.count()), nullptr);
+            }
+        }
+    }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct Request
+    {
+        std::string url;
+        Callback    callback;
+        Failure     failure;
+        std::size_t attempt = 0; // retries so far
+    };
+
+    struct Transfer
+    {
+        CURL*       handle;
+        Request     request;
+        std::string body;
+        char        error[CURL_ERROR_SIZE];
+        int64_t     begin; // trace clock
+    };
+
+    static std::size_t write(char* ptr, std::size_t size, std::size_t count, void* user)
+    {
+        reinterpret_cast<Transfer*>(user)->body.append(ptr, size * count);
+        return size * count;
+    }
+
+    void start(Request&& request)
+    {
+        Transfer* t = nullptr;
+        if (!idle.empty())
+        {
+            t = idle.back();
+            idle.pop_back();
+        }
+        else
+        {
+            transfers.push_back(std::make_unique<Transfer>());
+            t = transfers.back().get();
+            t->handle = curl_easy_init();
+            assert(t->handle);
+
+            curl_easy_setopt(t->handle, CURLOPT_PRIVATE, t);
+            curl_easy_setopt(t->handle, CURLOPT_WRITEFUNCTION, &Ingest::write);
+            curl_easy_setopt(t->handle, CURLOPT_WRITEDATA, t);
+            curl_easy_setopt(t->handle, CURLOPT_ERRORBUFFER, t->error);
+            curl_easy_setopt(t->handle, CURLOPT_TCP_KEEPALIVE, 1L);
+            curl_easy_setopt(t->handle, CURLOPT_ACCEPT_ENCODING, "");
+            curl_easy_setopt(t->handle, CURLOPT_TIMEOUT, timeout);
+        }
+
+        t->request = std::move(request);
+        t->body.clear();
+        t->error[0] = '\0';
+        t->begin = SFL_TRACE_NOW();
+        curl_easy_setopt(t->handle, CURLOPT_URL, t->request.url.c_str());
+
+        curl_multi_add_handle(multi, t->handle);
+        active++;
+    }
+
+    void finish(CURL* handle, CURLcode result)
+    {
+        Transfer* t = nullptr;
+        curl_easy_getinfo(handle, CURLINFO_PRIVATE, &t);
+        assert(t);
+
+        curl_multi_remove_handle(multi, handle);
+        active--;
+
+        long status = 0;
+        curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &status);
+
+        SFL_TRACE_COMPLETE("http.fetch", t->begin);
+        SFL_TRACE_COUNTER("http.bytes", t->body.size());
+
+        auto request = std::move(t->request);
+        t->request.callback = nullptr;
+        auto body = std::move(t->body);
+        idle.push_back(t);
+
+        // a non-HTTP transfer has no status
+        const bool ok = (result == CURLE_OK && (status == 0 || (status >= 200 && status < 300)));
+        if (ok)
+        {
+            detail::record(request.url, body);
+            deliver(request.callback, std::move(body));
+            return;
+        }
+
+        const auto error = request.url + ": " + (result != CURLE_OK
+            ? std::string(t->error[0] ? t->error : curl_easy_strerror(result))
+            : "HTTP " + std::to_string(status));
+
+        const bool transient = (result != CURLE_OK || status == 429 || status >= 500);
+        if (transient && request.attempt < retries)
+        {
+            const auto wait = backoff * (1 << std::min<std::size_t>(request.attempt, 16));
+            std::cerr << error << ", retrying in " << wait.count() << "ms\n";
+
+            request.attempt++;
+            delayed.emplace(clock::now() + wait, std::move(request));
+            return;
+        }
+
+        fail(request.failure, error);
+    }
+
+    static void fail(Failure& failure, const std::string& error)
+    {
+        std::cerr << error << '\n';
+        if (failure) failure(error);
+    }
+
+    void deliver(Callback& callback, std::string&& body)
+    {
+        try
+        {
+            callback(std::move(body));
+        }
+        catch(const std::exception& e)
+        {
+            std::cerr << e.what() << '\n';
+        }
+    }
+
+    std::size_t concurrency;
+    long timeout;
+    std::size_t retries;
+    std::chrono::milliseconds backoff;
+
+    CURLM* multi;
+    std::vector<std::unique_ptr<Transfer>> transfers;
+    std::vector<Transfer*> idle;
+    std::deque<Request> queued;
+    std::multimap<clock::time_point, Request> delayed;  // retries waiting out their backoff
+    std::deque<std::pair<std::string, Callback>> ready; // cached body, callback
+    std::size_t active = 0;
+};
+
+struct IngestResult
+{
+    std::size_t added = 0;           // bars
+    std::vector<std::string> failed; // tickers left out of the file
+};
+
+namespace detail
+{
+
+// Reads a pagination field without parsing the whole page, the object comes first in every response
+inline std::optional<uint32_t>
+paginationValue(const std::string& body, std::string_view field)
+{
+    const auto name = "\"" + std::string(field) + "\"";
+    const auto key = body.find(name);
+    if (key == std::string::npos) return std::nullopt;
+
+    auto it = body.data() + key + name.size();
+    const auto end = body.data() + body.size();
+    while (it != end && (*it == ':' || *it == ' ')) it++;
+
+    uint32_t value = 0;
+    const auto result = std::from_chars(it, end, value);
+    if (result.ec != std::errc()) return std::nullopt;
+    return value;
+}
+
+inline std::optional<uint32_t>
+paginationTotal(const std::string& body)
+{
+    return paginationValue(body, "total");
+}
+
+/*
+
+Parses responses and converts their bars on a worker thread while the
+network thread keeps requests in flight. Jobs are handled in the order they
+are queued, so a company always exists before its pages are converted. At
+most `depth` responses wait to be decoded, past that the network thread
+waits for the worker.
+
+Only the worker touches the universe while it runs. Tickers whose company
+or a page could not be decoded are remembered in `failed`.
+
+*/
+struct Decoder
+{
+    Decoder(File& _file, std::size_t _depth) :
+        file(_file),
+        depth(std::max<std::size_t>(_depth, 1)),
+        worker([this]() { run(); })
+    {
+        bars.reserve(1000);
+    }
+
+    ~Decoder()
+    {
+        finish();
+    }
+
+    // Registers a company that already is in the file by its companyKey, only its bars after `after` are kept
+    void known(const std::string& ticker, const std::string& key, std::size_t after)
+    {
+        std::lock_guard lock(mutex);
+        names[ticker] = Known{ key, after };
+    }
+
+    void company(const std::string& ticker, std::string&& body)
+    {
+        push(Job{ true, ticker, std::move(body) });
+    }
+
+    void page(const std::string& ticker, std::string&& body)
+    {
+        push(Job{ false, ticker, std::move(body) });
+    }
+
+    // Tickers whose company or one of whose pages could not be decoded, valid after finish()
+    std::unordered_set<std::string> failed;
+
+    // Waits for every queued job, returns the amount of bars added
+    std::size_t finish()
+    {
+        if (worker.joinable())
+        {
+            {
+                std::lock_guard lock(mutex);
+                done = true;
+            }
+            changed.notify_all();
+            worker.join();
+        }
+        return added;
+    }
+
+private:
+    struct Job
+    {
+        bool company;
+        std::string ticker, body;
+    };
+
+    struct Known
+    {
+        std::string key; // companyKey
+        std::size_t after = 0;
+    };
+
+    void push(Job&& job)
+    {
+        std::unique_lock lock(mutex);
+        changed.wait(lock, [&]() { return jobs.size() < depth; });
+        jobs.push_back(std::move(job));
+        lock.unlock();
+        changed.notify_all();
+    }
+
+    void run()
+    {
+        while (true)
+        {
+            Job job;
+            std::optional<Known> company;
+            {
+                std::unique_lock lock(mutex);
+                changed.wait(lock, [&]() { return done || !jobs.empty(); });
+                if (jobs.empty()) return;
+
+                job = std::move(jobs.front());
+                jobs.pop_front();
+
+                if (names.count(job.ticker)) company = names.at(job.ticker);
+            }
+            changed.notify_all();
+
+            try
+            {
+                SFL_TRACE_SCOPE("ingest.decode");
+                if (job.company)
+                {
+                    const auto company = addCompany(file, nlohmann::json::parse(job.body));
+                    std::lock_guard lock(mutex);
+                    names[job.ticker] = Known{ companyKey(company->name, company->ticker), 0 };
+                }
+                else if (company)
+                    added += addPage(file, company->key, job.body, bars, company->after);
+                else
+                    failed.insert(job.ticker);
+            }
+            catch(const std::exception& e)
+            {
+                std::cerr << job.ticker << ": " << e.what() << '\n';
+                failed.insert(job.ticker);
+            }
+        }
+    }
+
+    File& file;
+    std::size_t depth;
+
+    std::unordered_map<std::string, Known> names; // ticker, company
+    Bars bars; // page buffer, reused for every page
+    std::size_t added = 0;
+    std::deque<Job> jobs;
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool done = false;
+
+    std::thread worker;
+};
+
+struct FetchRequest
+{
+    std::string ticker;
+    std::string from_date, to_date;
+
+    // companyKey of a company already in the file, only its bars after `after` are added
+    std::optional<std::string> company;
+    std::size_t after = 0;
+};
+
+// Drops the bars a failed request added, and the company if it was new, from the file and the universe; returns the amount of bars dropped
+inline std::size_t
+rollback(File& file, const FetchRequest& r, std::size_t before)
+{
+    const auto drop = [](std::vector<util::id_t>& points, std::size_t from)
+    {
+        for (std::size_t i = from; i < points.size(); i++)
+            util::Universe::destroy(points[i]);
+
+        const auto dropped = points.size() - from;
+        points.resize(from);
+        return dropped;
+    };
+
+    if (r.company)
+        return drop(file.datapoints[util::Universe::getID(*r.company)], before);
+
+    const auto it = std::find_if(file.companies.begin(), file.companies.end(),
+        [&](util::id_t c) { return Company::get(c)->ticker == r.ticker; });
+    if (it == file.companies.end()) return 0;
+
+    const auto id = *it;
+    const auto company = Company::get(id);
+    const auto dropped = drop(file.datapoints[id], 0);
+
+    file.datapoints.erase(id);
+    file.companies.erase(it);
+
+    // the name only belongs to it if it wasn't taken already
+    const auto key = companyKey(company->name, company->ticker);
+    if (util::Universe::exists(key) && util::Universe::getID(key) == id) util::Universe::destroy(key);
+    else util::Universe::destroy(id);
+    return dropped;
+}
+
+/*
+
+Fetches every request into the file. Once a ticker's first page arrives its
+pagination total is known, so the remaining pages are queued right away and
+run concurrently with everything else, while the decoder converts the pages
+that have already arrived. A ticker with a request that failed for good, or
+a response that could not be decoded, is rolled back to what the file had
+before and reported in `failed`.
+
+*/
+IngestResult
+fetch(
+    File& file,
+    const std::vector<FetchRequest>& requests,
+    std::size_t concurrency)
+{
+    Ingest ingest(concurrency);
+    Decoder decoder(file, concurrency);
+
+    std::unordered_set<std::string> failed;
+    const auto failure = [&](const std::string& ticker)
+    {
+        return [&, ticker](const std::string&) { failed.insert(ticker); };
+    };
+
+    // bars of every known company before the fetch, read before the decoder has any work
+    std::vector<std::size_t> before(requests.size(), 0);
+    for (std::size_t i = 0; i < requests.size(); i++)
+        if (requests[i].company)
+            before[i] = file.datapoints[util::Universe::getID(*requests[i].company)].size();
+
+    const auto pages = [&](const FetchRequest& r)
+    {
+        const auto url = [&, r](uint32_t offset)
+        {
+            return intradayURL(r.ticker, "30min", r.from_date, r.to_date, std::to_string(offset));
+        };
+
+        ingest.get(
+            url(0),
+            [&, url, ticker = r.ticker](std::string&& body)
+            {
+                // the server may return fewer rows per page than were asked for
+                const auto total = paginationTotal(body).value_or(0);
+                const auto limit = std::max<uint32_t>(paginationValue(body, "limit").value_or(1000), 1);
+                for (uint32_t offset = limit; offset < total; offset += limit)
+                    ingest.get(url(offset), [&, ticker](std::string&& body) { decoder.page(ticker, std::move(body)); }, failure(ticker));
+
+                decoder.page(ticker, std::move(body));
+            },
+            failure(r.ticker)
+        );
+    };
+
+    for (const auto& r : requests)
+    {
+        if (r.company)
+        {
+            decoder.known(r.ticker, *r.company, r.after);
+            pages(r);
+            continue;
+        }
+
+        ingest.get(
+            companyURL(r.ticker),
+            [&, r](std::string&& body)
+            {
+                decoder.company(r.ticker, std::move(body));
+                pages(r);
+            },
+            failure(r.ticker)
+        );
+    }
+
+    ingest.run();
+
+    IngestResult result;
+    result.added = decoder.finish();
+    failed.insert(decoder.failed.begin(), decoder.failed.end());
+
+    for (std::size_t i = 0; i < requests.size(); i++)
+    {
+        if (!failed.count(requests[i].ticker)) continue;
+
+        result.added -= rollback(file, requests[i], before[i]);
+        result.failed.push_back(requests[i].ticker);
+    }
+
+    return result;
+}
+
+std::vector<FetchRequest>
+yearRequests(const File& file, const std::vector<std::string>& tickers, uint16_t year)
+{
+    const auto start_date = (std::stringstream() << year << "-01-01").str();
+    const auto end_date   = (std::stringstream() << year << "-12-31").str();
+
+    std::vector<FetchRequest> requests;
+    for (const auto& ticker : tickers)
+        if (!hasTicker(file, ticker))
+            requests.push_back(FetchRequest{ ticker, start_date, end_date });
+    return requests;
+}
+
+} // namespace detail
+
+// Adds every ticker that isn't in the year file yet, fetching them concurrently
+IngestResult
+addCompanies(
+    const std::vector<std::string>& tickers,
+    uint16_t year,
+    std::size_t concurrency = 8)
+{
+    File file;
+    const std::string filename = detail::yearFilename(year);
+    detail::loadYear(file, filename);
+
+    const auto result = detail::fetch(file, detail::yearRequests(file, tickers, year), concurrency);
+    file.write(filename);
+    return result;
+}
+
+// Adds a single ticker, its pages are fetched `depth` at a time
+IngestResult
+addCompany(
+    const std::string& ticker,
+    uint16_t year,
+    std::size_t depth = 4)
+{
+    File file;
+    const std::string filename = detail::yearFilename(year);
+    detail::loadYear(file, filename);
+
+    if (detail::hasTicker(file, ticker)) return {};
+
+    IngestResult result;
+    try
+    {
+        result = detail::fetch(file, detail::yearRequests(file, { ticker }, year), depth);
+        if (result.failed.empty()) file.write(filename);
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        result.failed = { ticker };
+    }
+    return result;
+}
+
+/*
+
+Brings the given tickers of a year file up to date. The last stored time of
+every company is read from the file index, and only the range from that day
+to the end of the year is requested; bars at or before the last stored time
+are dropped. Tickers not in the file are fetched in full. The file is
+loaded before fetching, since pages are decoded into it as they arrive, but
+only when there is something to request, and it is only rewritten if new
+bars arrived. Returns the amount of bars added and the tickers that failed,
+which keep what the file had.
+
+*/
+IngestResult
+updateCompanies(
+    const std::vector<std::string>& tickers,
+    uint16_t year,
+    std::size_t concurrency = 8)
+{
+    const std::string filename = detail::yearFilename(year);
+    const auto start_date = (std::stringstream() << year << "-01-01").str();
+    const auto end_date   = (std::stringstream() << year << "-12-31").str();
+
+    FileIndex index;
+    const bool exists = index.read(filename);
+
+    std::vector<detail::FetchRequest> requests;
+    std::unordered_set<std::string> seen;
+    for (const auto& ticker : tickers)
+    {
+        if (!seen.insert(ticker).second) continue;
+
+        const auto* entry = (exists ? index.find(ticker) : nullptr);
+        if (!entry)
+        {
+            requests.push_back(detail::FetchRequest{ ticker, start_date, end_date });
+            continue;
+        }
+
+        // the last day is requested again since it may have been partial
+        requests.push_back(detail::FetchRequest{
+            .ticker    = ticker,
+            .from_date = entry->count ? formatISO8601(static_cast<int64_t>(entry->last)).substr(0, 10) : start_date,
+            .to_date   = end_date,
+            .company   = companyKey(entry->name, entry->ticker),
+            .after     = entry->last
+        });
+    }
+
+    if (requests.empty()) return {};
+
+    File file;
+    if (exists) file.load(filename);
+
+    IngestResult result;
+    try
+    {
+        result = detail::fetch(file, requests, concurrency);
+        if (result.added) file.write(filename);
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        result = IngestResult{};
+        for (const auto& r : requests) result.failed.push_back(r.ticker);
+    }
+
+    return result;
+}
+
+IngestResult
+updateCompany(
+    const std::string& ticker,
+    uint16_t year,
+    std::size_t depth = 4)
+{
+    return updateCompanies({ ticker }, year, depth);
+}
+
+}
@@ -29,6 +29,13 @@ private:
     util::id_t exchange;
 };
 
+// The name a company is registered under in the universe: its ticker, since share
+// classes of one issuer (GOOG, GOOGL) have the same name, or the name without one
+inline std::string companyKey(const std::string& name, const std::string& ticker)
+{
+    return (ticker.empty() ? name : ticker);
+}
+
 struct Datapoint : util::Factory<Datapoint>
 {
     Datapoint(util::id_t id, util::id_t c) :
@@ -41,8 +48,6 @@ struct Datapoint : util::Factory<Datapoint>
 
     const util::id_t& companyID() const { return company; }
 
-    constexpr static std::size_t byte_size = sizeof(double) * 6 + sizeof(std::size_t) + sizeof(index_type);
-
 private:
     util::id_t company;
 };
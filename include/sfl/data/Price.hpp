@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string_view>
+
+#include <sfl/def.hpp>
+
+namespace sfl
+{
+
+/*
+
+How prices (open, high, low, last, close) and volume are represented, in
+memory and in .sft records. Each policy has a value_type for prices and a
+volume_type, and converts to and from double:
+
+    DoublePrice  double / double, exact
+    FloatPrice   float / float. encode rounds to the nearest float (ties to
+                 even), about 7 significant digits, so volumes above 2^24 lose
+                 their last units. decode widens exactly. NaN stays NaN.
+    TickPrice    int64_t ticks of 1/Scale / int64_t units. encode rounds
+                 price * Scale, computed in double, to the nearest integer
+                 (ties away from zero), decode is the nearest double to
+                 ticks / Scale, so encode(decode(t)) == t for any tick count
+                 below 2^53 / Scale. NaN (a missing price) is stored as the
+                 smallest int64_t; anything else saturates, so +inf and
+                 values too large for int64_t become the largest int64_t,
+                 -inf and values too small the smallest int64_t + 1. A
+                 number is never stored as missing. Volumes likewise.
+
+Conversions between policies always go through double.
+
+*/
+enum class PriceFormat : uint8_t
+{
+    Double = 0, Float = 1, Ticks = 2
+};
+
+struct DoublePrice
+{
+    using value_type  = double;
+    using volume_type = double;
+    static constexpr PriceFormat format = PriceFormat::Double;
+
+    static constexpr value_type  encode(double v)       { return v; }
+    static constexpr double      decode(value_type v)   { return v; }
+    static constexpr volume_type encodeVolume(double v) { return v; }
+    static constexpr double      decodeVolume(volume_type v) { return v; }
+};
+
+struct FloatPrice
+{
+    using value_type  = float;
+    using volume_type = float;
+    static constexpr PriceFormat format = PriceFormat::Float;
+
+    static constexpr value_type  encode(double v)       { return static_cast<float>(v); }
+    static constexpr double      decode(value_type v)   { return static_cast<double>(v); }
+    static constexpr volume_type encodeVolume(double v) { return static_cast<float>(v); }
+    static constexpr double      decodeVolume(volume_type v) { return static_cast<double>(v); }
+};
+
+template<int64_t Scale = 10000>
+struct TickPrice
+{
+    using value_type  = int64_t;
+    using volume_type = int64_t;
+    static constexpr PriceFormat format = PriceFormat::Ticks;
+    static constexpr int64_t scale   = Scale;
+    static constexpr int64_t missing = std::numeric_limits<int64_t>::min();
+
+    static value_type encode(double v)
+    {
+        return round(v * static_cast<double>(Scale));
+    }
+
+    static constexpr double decode(value_type v)
+    {
+        return (v == missing ? std::numeric_limits<double>::quiet_NaN() : static_cast<double>(v) / static_cast<double>(Scale));
+    }
+
+    static volume_type encodeVolume(double v) { return round(v); }
+    static constexpr double decodeVolume(volume_type v) { return (v == missing ? std::numeric_limits<double>::quiet_NaN() : static_cast<double>(v)); }
+
+    // Nearest integer (ties away from zero), saturated to (missing, max]; NaN is missing
+    static value_type round(double v)
+    {
+        constexpr double bound = 9223372036854775808.0; // 2^63
+
+        if (std::isnan(v)) return missing;
+
+        const double r = std::round(v);
+        if (r >= bound)  return std::numeric_limits<int64_t>::max();
+        if (r <= -bound) return missing + 1;
+        return static_cast<int64_t>(r);
+    }
+};
+
+// Ticks of 1e-4, the resolution of the .sft Ticks format
+using Ticks = TickPrice<10000>;
+
+// Calls f with a default constructed policy of the format
+template<typename F>
+decltype(auto) visitPrice(PriceFormat format, F&& f)
+{
+    switch (format)
+    {
+    case PriceFormat::Float: return f(FloatPrice());
+    case PriceFormat::Ticks: return f(Ticks());
+    default:                 return f(DoublePrice());
+    }
+}
+
+inline const char* name(PriceFormat format)
+{
+    switch (format)
+    {
+    case PriceFormat::Float: return "float";
+    case PriceFormat::Ticks: return "ticks";
+    default:                 return "double";
+    }
+}
+
+inline std::optional<PriceFormat> parsePriceFormat(std::string_view s)
+{
+    if (s == "double") return PriceFormat::Double;
+    if (s == "float")  return PriceFormat::Float;
+    if (s == "ticks")  return PriceFormat::Ticks;
+    return std::nullopt;
+}
+
+}
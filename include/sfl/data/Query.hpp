@@ -0,0 +1,461 @@
+#pragma once
+
+#include <map>
+#include <cmath>
+
+#include <sfl/def.hpp>
+#include <sfl/util/MappedFile.hpp>
+#include <sfl/util/Simd.hpp>
+#include <sfl/util/Time.hpp>
+
+#include "File.hpp"
+
+namespace sfl
+{
+
+namespace query
+{
+
+// Columns of a bar, in the order they are stored in a record
+enum class Field : uint8_t
+{
+    Open, High, Low, Last, Close, Volume, Time
+};
+
+enum class Op : uint8_t
+{
+    Less, LessEqual, Greater, GreaterEqual, Equal, NotEqual
+};
+
+enum class Aggregate : uint8_t
+{
+    Count, Sum, Mean, Min, Max, First, Last
+};
+
+enum class Group : uint8_t
+{
+    None, Ticker, Exchange
+};
+
+inline const char* name(Field f)
+{
+    constexpr const char* names[] = { "open", "high", "low", "last", "close", "volume", "time" };
+    return names[static_cast<int>(f)];
+}
+
+inline const char* name(Aggregate a)
+{
+    constexpr const char* names[] = { "count", "sum", "mean", "min", "max", "first", "last" };
+    return names[static_cast<int>(a)];
+}
+
+struct Predicate
+{
+    Field  field;
+    Op     op;
+    double value;
+};
+
+/*
+
+Rows of a query. With aggregates there is one row per group (and time
+bucket), otherwise one row per selected bar. `values` holds one column per
+aggregate or projected field, named in `columns`.
+
+*/
+struct Result
+{
+    std::vector<std::string> columns;
+    std::vector<std::string> keys;    // ticker or exchange of every row, empty without grouping
+    std::vector<int64_t>     times;   // bucket start, or the bar's time for projections
+    std::vector<std::vector<double>> values;
+
+    // how much of the data was touched
+    std::size_t files = 0, files_skipped = 0;
+    std::size_t sections = 0, sections_skipped = 0;
+    std::size_t bars_scanned = 0;
+
+    std::size_t rows() const { return keys.size(); }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const Result& r)
+{
+    char cell[64];
+    os << "key\ttime";
+    for (const auto& c : r.columns) os << '\t' << c;
+    os << '\n';
+
+    for (std::size_t i = 0; i < r.rows(); i++)
+    {
+        os << r.keys[i] << '\t' << (r.times[i] == std::numeric_limits<int64_t>::min() ? std::string("-") : formatISO8601(r.times[i]));
+        for (const auto& column : r.values)
+        {
+            std::snprintf(cell, sizeof(cell), "%.10g", column[i]);
+            os << '\t' << cell;
+        }
+        os << '\n';
+    }
+    return os;
+}
+
+namespace detail
+{
+
+inline std::size_t recordTime(const char* record, const RecordLayout& layout)
+{
+    return schema::load<std::size_t>(record + layout.time_offset);
+}
+
+// Copies one field of `count` records, stored as `prices`, into a column
+inline void decode(const char* records, std::size_t count, Field field, PriceFormat prices, std::vector<double>& out)
+{
+    out.resize(count);
+    visitPrice(prices, [&](auto policy)
+    {
+        using P = decltype(policy);
+        using S = BarSchema<P>;
+
+        // query fields are in record order
+        static_assert(static_cast<std::size_t>(Field::Time) == static_cast<std::size_t>(BarField::Time));
+        S::visit(static_cast<std::size_t>(field), [&](auto index)
+        {
+            constexpr auto I = decltype(index)::value;
+            for (std::size_t i = 0; i < count; i++)
+            {
+                const auto v = S::template read<I>(records + i * S::record_size);
+                if constexpr (I == static_cast<std::size_t>(BarField::Volume)) out[i] = P::decodeVolume(v);
+                else if constexpr (I >= static_cast<std::size_t>(BarField::Time)) out[i] = static_cast<double>(v);
+                else out[i] = P::decode(v);
+            }
+        });
+    });
+}
+
+// mask[i] &= column[i] <op> value, branch free so it vectorizes
+inline void filter(const std::vector<double>& column, Op op, double value, std::vector<uint8_t>& mask)
+{
+    const auto n = column.size();
+    const double* v = column.data();
+    uint8_t* m = mask.data();
+
+    switch (op)
+    {
+    case Op::Less:         for (std::size_t i = 0; i < n; i++) m[i] &= (v[i] <  value); break;
+    case Op::LessEqual:    for (std::size_t i = 0; i < n; i++) m[i] &= (v[i] <= value); break;
+    case Op::Greater:      for (std::size_t i = 0; i < n; i++) m[i] &= (v[i] >  value); break;
+    case Op::GreaterEqual: for (std::size_t i = 0; i < n; i++) m[i] &= (v[i] >= value); break;
+    case Op::Equal:        for (std::size_t i = 0; i < n; i++) m[i] &= (v[i] == value); break;
+    case Op::NotEqual:     for (std::size_t i = 0; i < n; i++) m[i] &= (v[i] != value); break;
+    }
+}
+
+// Running aggregate of one field over one group, partial states merge in time order
+struct State
+{
+    double count = 0, sum = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    double first = std::numeric_limits<double>::quiet_NaN(), last = first;
+    std::size_t first_time = std::numeric_limits<std::size_t>::max(), last_time = 0;
+
+    void merge(const State& s)
+    {
+        if (!s.count) return;
+        count += s.count;
+        sum   += s.sum;
+        min    = std::min(min, s.min);
+        max    = std::max(max, s.max);
+        if (s.first_time < first_time) { first = s.first; first_time = s.first_time; }
+        if (s.last_time >= last_time)  { last  = s.last;  last_time  = s.last_time; }
+    }
+
+    double get(Aggregate a) const
+    {
+        switch (a)
+        {
+        case Aggregate::Count: return count;
+        case Aggregate::Sum:   return sum;
+        case Aggregate::Mean:  return count ? sum / count : std::numeric_limits<double>::quiet_NaN();
+        case Aggregate::Min:   return count ? min : std::numeric_limits<double>::quiet_NaN();
+        case Aggregate::Max:   return count ? max : std::numeric_limits<double>::quiet_NaN();
+        case Aggregate::First: return first;
+        case Aggregate::Last:  return last;
+        }
+        return 0.0;
+    }
+};
+
+/*
+
+Aggregates rows [begin, end) of a column. Without a mask (no value
+predicates) the sum runs on SIMD lanes and min/max are plain reductions;
+with one, rows are blended instead of branched on.
+
+*/
+inline State
+reduce(const std::vector<double>& column, const std::vector<double>& times, const std::vector<uint8_t>* mask, std::size_t begin, std::size_t end)
+{
+    State s;
+    const double* v = column.data();
+    if (begin >= end) return s;
+
+    if (!mask)
+    {
+        s.count = static_cast<double>(end - begin);
+        s.sum   = util::sum(v + begin, end - begin);
+
+        double lo = v[begin], hi = v[begin];
+        for (std::size_t i = begin; i < end; i++)
+        {
+            lo = std::min(lo, v[i]);
+            hi = std::max(hi, v[i]);
+        }
+        s.min = lo;
+        s.max = hi;
+
+        s.first = v[begin];
+        s.last  = v[end - 1];
+        s.first_time = static_cast<std::size_t>(times[begin]);
+        s.last_time  = static_cast<std::size_t>(times[end - 1]);
+        return s;
+    }
+
+    const uint8_t* m = mask->data();
+    double count = 0, sum = 0;
+    double lo = std::numeric_limits<double>::infinity(), hi = -lo;
+    for (std::size_t i = begin; i < end; i++)
+    {
+        const bool keep = m[i];
+        count += keep;
+        sum   += keep ? v[i] : 0.0;
+        lo     = keep ? std::min(lo, v[i]) : lo;
+        hi     = keep ? std::max(hi, v[i]) : hi;
+    }
+    s.count = count;
+    s.sum   = sum;
+    s.min   = lo;
+    s.max   = hi;
+
+    if (count)
+    {
+        auto i = begin;
+        while (!m[i]) i++;
+        s.first = v[i];
+        s.first_time = static_cast<std::size_t>(times[i]);
+
+        auto j = end - 1;
+        while (!m[j]) j--;
+        s.last = v[j];
+        s.last_time = static_cast<std::size_t>(times[j]);
+    }
+
+    return s;
+}
+
+} // namespace detail
+
+/*
+
+Filter, projection, grouping and aggregation over .sft files, without loading
+them into a File.
+
+Ticker, exchange and time predicates are pushed down into the file layout:
+files whose date range misses the time range are skipped after reading the
+header, sections of other tickers or exchanges (or outside the time range)
+are never touched, and within a section the time range is found by binary
+search on the mapped records. Only the fields a query uses are decoded, into
+columns that the value predicates and aggregates run over a column at a time.
+
+    auto r = query::Query()
+        .exchanges({ "NASDAQ" })
+        .between(april, july)
+        .groupBy(query::Group::Ticker)
+        .aggregate(query::Field::Volume, query::Aggregate::Max)
+        .run({ "2023.sft" });
+
+*/
+struct Query
+{
+    Query& tickers(std::vector<std::string> t)   { ticker_set = std::move(t); return *this; }
+    Query& exchanges(std::vector<std::string> e) { exchange_set = std::move(e); return *this; }
+
+    // [from, to) in unix seconds
+    Query& between(std::size_t from, std::size_t to) { time_from = from; time_to = to; return *this; }
+
+    Query& where(Field field, Op op, double value) { predicates.push_back(Predicate{ field, op, value }); return *this; }
+
+    Query& select(std::vector<Field> fields) { projection = std::move(fields); return *this; }
+
+    Query& aggregate(Field field, Aggregate a) { aggregates.push_back(std::pair(field, a)); return *this; }
+
+    // Groups rows by ticker or exchange and, with `bucket` seconds, by time bucket too
+    Query& groupBy(Group g, int64_t bucket = 0) { group = g; bucket_size = bucket; return *this; }
+
+    Result run(const std::vector<std::string>& files) const
+    {
+        Result result;
+        const bool aggregating = !aggregates.empty();
+
+        for (const auto& a : aggregates)
+            result.columns.push_back(std::string(name(a.second)) + "(" + name(a.first) + ")");
+        for (const auto& f : projection)
+            if (!aggregating) result.columns.push_back(name(f));
+
+        if (!aggregating) result.values.resize(projection.size());
+
+        // every field the query reads
+        std::vector<Field> fields = { Field::Time };
+        const auto need = [&](Field f) { if (std::find(fields.begin(), fields.end(), f) == fields.end()) fields.push_back(f); };
+        for (const auto& p : predicates) need(p.field);
+        for (const auto& a : aggregates) need(a.first);
+        if (!aggregating) for (const auto& f : projection) need(f);
+
+        std::array<std::vector<double>, 7> columns;
+        std::vector<uint8_t> mask;
+
+        // group (key, bucket) -> one state per aggregate
+        std::map<std::pair<std::string, int64_t>, std::vector<detail::State>> groups;
+        std::vector<detail::State> reduced; // of one run, by aggregate
+
+        for (const auto& filename : files)
+        {
+            FileIndex index;
+            if (!index.read(filename)) continue;
+
+            if (index.end_date < time_from || index.start_date >= time_to)
+            {
+                result.files_skipped++;
+                continue;
+            }
+
+            util::MappedFile mapped(filename);
+            if (!mapped) continue;
+            result.files++;
+
+            const char* data = mapped.view().data();
+            const auto layout = recordLayout(index.prices);
+
+            for (const auto& company : index.companies)
+            {
+                const auto& exchange = index.exchanges[company.exchange].name;
+
+                if (!matches(ticker_set, company.ticker) || !matches(exchange_set, exchange) ||
+                    !company.count || company.last < time_from || company.first >= time_to)
+                {
+                    result.sections_skipped++;
+                    continue;
+                }
+                result.sections++;
+
+                // binary search the time range within the section
+                const char* records = data + company.offset;
+                const auto time_at = [&](std::size_t i) { return detail::recordTime(records + i * layout.record_size, layout); };
+
+                std::size_t lo = 0, hi = company.count;
+                while (lo < hi) { const auto mid = (lo + hi) / 2; if (time_at(mid) < time_from) lo = mid + 1; else hi = mid; }
+                const auto begin = lo;
+
+                hi = company.count;
+                while (lo < hi) { const auto mid = (lo + hi) / 2; if (time_at(mid) < time_to) lo = mid + 1; else hi = mid; }
+                const auto end = lo;
+
+                if (begin >= end) continue;
+
+                const auto n = end - begin;
+                const char* slice = records + begin * layout.record_size;
+                result.bars_scanned += n;
+
+                for (const auto f : fields)
+                    detail::decode(slice, n, f, index.prices, columns[static_cast<int>(f)]);
+
+                const std::vector<uint8_t>* selected = nullptr;
+                if (!predicates.empty())
+                {
+                    mask.assign(n, 1);
+                    for (const auto& p : predicates)
+                        detail::filter(columns[static_cast<int>(p.field)], p.op, p.value, mask);
+                    selected = &mask;
+                }
+
+                const auto& times = columns[static_cast<int>(Field::Time)];
+                const auto& key = (group == Group::Ticker ? company.ticker : group == Group::Exchange ? exchange : empty);
+
+                if (!aggregating)
+                {
+                    for (std::size_t i = 0; i < n; i++)
+                    {
+                        if (selected && !mask[i]) continue;
+                        result.keys.push_back(company.ticker);
+                        result.times.push_back(static_cast<int64_t>(times[i]));
+                        for (std::size_t c = 0; c < projection.size(); c++)
+                            result.values[c].push_back(columns[static_cast<int>(projection[c])][i]);
+                    }
+                    continue;
+                }
+
+                // sections are sorted, so every time bucket is a contiguous run
+                std::size_t run_begin = 0;
+                while (run_begin < n)
+                {
+                    auto run_end = n;
+                    int64_t bucket = std::numeric_limits<int64_t>::min();
+                    if (bucket_size > 0)
+                    {
+                        bucket = floorDiv(static_cast<int64_t>(times[run_begin]), bucket_size) * bucket_size;
+                        run_end = run_begin;
+                        while (run_end < n && static_cast<int64_t>(times[run_end]) < bucket + bucket_size) run_end++;
+                    }
+
+                    reduced.clear();
+                    for (const auto& aggregate : aggregates)
+                        reduced.push_back(detail::reduce(columns[static_cast<int>(aggregate.first)], times, selected, run_begin, run_end));
+
+                    // every aggregate sees the same rows, a run the predicates filtered out entirely makes no group
+                    if (reduced.front().count > 0)
+                    {
+                        auto& states = groups[std::pair(key, bucket)];
+                        states.resize(aggregates.size());
+                        for (std::size_t a = 0; a < aggregates.size(); a++)
+                            states[a].merge(reduced[a]);
+                    }
+
+                    run_begin = run_end;
+                }
+            }
+        }
+
+        if (aggregating)
+        {
+            result.values.resize(aggregates.size());
+            for (const auto& [key, states] : groups)
+            {
+                result.keys.push_back(key.first);
+                result.times.push_back(key.second);
+                for (std::size_t a = 0; a < aggregates.size(); a++)
+                    result.values[a].push_back(states[a].get(aggregates[a].second));
+            }
+        }
+
+        return result;
+    }
+
+private:
+    static bool matches(const std::vector<std::string>& set, const std::string& value)
+    {
+        return set.empty() || std::find(set.begin(), set.end(), value) != set.end();
+    }
+
+    std::vector<std::string> ticker_set, exchange_set;
+    std::size_t time_from = 0, time_to = std::numeric_limits<std::size_t>::max();
+    std::vector<Predicate> predicates;
+    std::vector<Field> projection;
+    std::vector<std::pair<Field, Aggregate>> aggregates;
+    Group group = Group::None;
+    int64_t bucket_size = 0;
+
+    inline static const std::string empty;
+};
+
+} // namespace query
+
+}
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <tuple>
+#include <utility>
+
+#include <sfl/def.hpp>
+
+#include "Bars.hpp"
+
+namespace sfl
+{
+
+namespace schema
+{
+
+// Files are little endian, big endian hosts swap bytes on every load and store
+template<typename T>
+constexpr T little(T v)
+{
+    if constexpr (std::endian::native == std::endian::little || sizeof(T) == 1)
+        return v;
+    else
+    {
+        auto bytes = std::bit_cast<std::array<std::byte, sizeof(T)>>(v);
+        std::reverse(bytes.begin(), bytes.end());
+        return std::bit_cast<T>(bytes);
+    }
+}
+
+template<typename T>
+inline T load(const char* p)
+{
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+    return little(v);
+}
+
+template<typename T>
+inline void store(char* p, T v)
+{
+    v = little(v);
+    std::memcpy(p, &v, sizeof(T));
+}
+
+namespace detail
+{
+
+template<typename M>
+struct member;
+
+template<typename C, typename T>
+struct member<std::vector<T> C::*>
+{
+    using columns = C;
+    using type    = T;
+};
+
+} // namespace detail
+
+// A field held in a column (a std::vector member) of a struct of arrays
+template<auto Member>
+struct Column
+{
+    using columns = typename detail::member<decltype(Member)>::columns;
+    using type    = typename detail::member<decltype(Member)>::type;
+    static constexpr auto member = Member;
+    static constexpr bool constant = false;
+};
+
+// A field with the same value in every record of a batch, given to encode() and skipped by decode()
+template<typename T>
+struct Constant
+{
+    using type = T;
+    static constexpr bool constant = true;
+};
+
+/*
+
+A record layout known at compile time: the fields, in order, packed with no
+padding. From it come the offsets and the record size, and codecs that
+transpose whole arrays of records to and from a struct of arrays one field
+at a time, a tight strided loop per field with no branches and no per
+record calls. Adding a field to a schema is all it takes to store it.
+
+*/
+template<typename... Fields>
+struct Schema
+{
+    static constexpr std::size_t fields = sizeof...(Fields);
+
+    static constexpr std::array<std::size_t, fields> sizes = { sizeof(typename Fields::type)... };
+
+    static constexpr std::array<std::size_t, fields + 1> offsets = []()
+    {
+        std::array<std::size_t, fields + 1> o{};
+        for (std::size_t i = 0; i < fields; i++) o[i + 1] = o[i] + sizes[i];
+        return o;
+    }();
+
+    static constexpr std::size_t record_size = offsets[fields];
+
+    template<std::size_t I>
+    using field = std::tuple_element_t<I, std::tuple<Fields...>>;
+
+    // Field I of one record
+    template<std::size_t I>
+    static typename field<I>::type read(const char* record)
+    {
+        return load<typename field<I>::type>(record + offsets[I]);
+    }
+
+    // Writes rows [begin, begin + n) of the columns as n records, `constants` fill the Constant fields in order
+    template<typename Columns, typename... Constants>
+    static void encode(const Columns& columns, std::size_t begin, std::size_t n, char* out, const Constants&... constants)
+    {
+        const std::tuple<const Constants&...> values(constants...);
+        [&]<std::size_t... I>(std::index_sequence<I...>)
+        {
+            (encodeField<I>(columns, begin, n, out, values), ...);
+        }(std::index_sequence_for<Fields...>());
+    }
+
+    // Reads n records into the columns, which are resized to n
+    template<typename Columns>
+    static void decode(const char* in, std::size_t n, Columns& columns)
+    {
+        [&]<std::size_t... I>(std::index_sequence<I...>)
+        {
+            (decodeField<I>(in, n, columns), ...);
+        }(std::index_sequence_for<Fields...>());
+    }
+
+    // Calls f with std::integral_constant<std::size_t, index>, for fields picked at run time
+    template<typename F>
+    static void visit(std::size_t index, F&& f)
+    {
+        [&]<std::size_t... I>(std::index_sequence<I...>)
+        {
+            ((index == I ? (f(std::integral_constant<std::size_t, I>()), 0) : 0), ...);
+        }(std::index_sequence_for<Fields...>());
+    }
+
+private:
+    // position of field I among the Constant fields
+    template<std::size_t I>
+    static constexpr std::size_t constantIndex()
+    {
+        constexpr std::array<bool, fields> constant = { Fields::constant... };
+        std::size_t k = 0;
+        for (std::size_t i = 0; i < I; i++) k += constant[i];
+        return k;
+    }
+
+    template<std::size_t I, typename Columns, typename Values>
+    static void encodeField(const Columns& columns, std::size_t begin, std::size_t n, char* out, const Values& values)
+    {
+        using F = field<I>;
+        using T = typename F::type;
+        char* it = out + offsets[I];
+
+        if constexpr (F::constant)
+        {
+            const T value = std::get<constantIndex<I>()>(values);
+            for (std::size_t i = 0; i < n; i++)
+                store<T>(it + i * record_size, value);
+        }
+        else
+        {
+            const T* src = (columns.*F::member).data() + begin;
+            for (std::size_t i = 0; i < n; i++)
+                store<T>(it + i * record_size, src[i]);
+        }
+    }
+
+    template<std::size_t I, typename Columns>
+    static void decodeField(const char* in, std::size_t n, Columns& columns)
+    {
+        using F = field<I>;
+        using T = typename F::type;
+
+        if constexpr (!F::constant)
+        {
+            auto& column = columns.*F::member;
+            column.resize(n);
+
+            const char* it = in + offsets[I];
+            T* dst = column.data();
+            for (std::size_t i = 0; i < n; i++)
+                dst[i] = load<T>(it + i * record_size);
+        }
+    }
+};
+
+} // namespace schema
+
+/*
+
+The bar record of a .sft file: the prices and volume in the representation
+of P, the time and the index of the company in the file.
+
+*/
+template<typename P>
+using BarSchema = schema::Schema<
+    schema::Column<&BasicBars<P>::open>,
+    schema::Column<&BasicBars<P>::high>,
+    schema::Column<&BasicBars<P>::low>,
+    schema::Column<&BasicBars<P>::last>,
+    schema::Column<&BasicBars<P>::close>,
+    schema::Column<&BasicBars<P>::volume>,
+    schema::Column<&BasicBars<P>::time>,
+    schema::Constant<index_type>>;
+
+// Field positions in BarSchema
+enum class BarField : std::size_t
+{
+    Open, High, Low, Last, Close, Volume, Time, Company
+};
+
+/*
+
+Layout of a bar record in a .sft file of the given format, taken from its
+schema.
+
+*/
+struct RecordLayout
+{
+    std::size_t value_size;  // of each of the six values
+    std::size_t time_offset;
+    std::size_t record_size;
+};
+
+inline RecordLayout recordLayout(PriceFormat format)
+{
+    return visitPrice(format, [](auto policy)
+    {
+        using S = BarSchema<decltype(policy)>;
+        return RecordLayout{ S::sizes[0], S::offsets[static_cast<std::size_t>(BarField::Time)], S::record_size };
+    });
+}
+
+}
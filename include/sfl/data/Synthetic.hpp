@@ -0,0 +1,213 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <random>
+#include <cmath>
+
+#include <sfl/def.hpp>
+#include <sfl/util/Time.hpp>
+
+#include "File.hpp"
+
+namespace sfl
+{
+
+struct SyntheticOptions
+{
+    std::size_t tickers    = 100;
+    std::size_t exchanges  = 1;
+    int32_t     first_year = 2023;
+    std::size_t years      = 1;
+    int64_t     interval   = 1800; // seconds between bars
+
+    double missing     = 0.0;  // chance that a bar is left out
+    double drift       = 0.05; // annualized
+    double volatility  = 0.3;  // annualized
+    double correlation = 0.0;  // between any two tickers, through one market factor
+
+    bool        sessions = false; // only bars while the NYSE is open
+    std::vector<int64_t> rollups; // intervals (seconds) stored alongside the bars, see Writer
+    PriceFormat prices = PriceFormat::Double; // of the records
+    uint64_t    seed     = 1;
+    std::size_t threads  = std::max(1u, std::thread::hardware_concurrency());
+};
+
+struct SyntheticResult
+{
+    std::size_t bars = 0;
+    std::vector<std::string> files;
+};
+
+namespace detail
+{
+
+inline uint64_t splitmix(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+/*
+
+Bars of one ticker for one year. Prices follow geometric Brownian motion in
+calendar time, the shock of every step mixes the shared market shock with the
+ticker's own so any two tickers correlate by `correlation`. Each bar opens at
+the previous close. The first and last bar of the year are never left out,
+every missing bar in between has a neighbour on both sides to be
+interpolated from.
+
+*/
+inline void
+syntheticBars(
+    const SyntheticOptions& options,
+    std::span<const int64_t> times,
+    std::span<const double> market,
+    uint64_t seed,
+    double& price,
+    Bars& bars)
+{
+    bars.clear();
+    bars.reserve(times.size());
+
+    std::mt19937_64 random(seed);
+    std::normal_distribution<double> normal;
+    std::uniform_real_distribution<double> uniform;
+
+    constexpr double seconds_per_year = 365.25 * 86400.0;
+    const double own = std::sqrt(1.0 - options.correlation);
+    const double common = std::sqrt(options.correlation);
+    const double sigma2 = options.volatility * options.volatility;
+
+    for (std::size_t i = 0; i < times.size(); i++)
+    {
+        const double dt  = static_cast<double>(i ? times[i] - times[i - 1] : options.interval) / seconds_per_year;
+        const double sd  = options.volatility * std::sqrt(dt);
+        const double z   = common * market[i] + own * normal(random);
+
+        const double open = price;
+        price *= std::exp((options.drift - 0.5 * sigma2) * dt + sd * z);
+
+        const double high   = std::max(open, price) * (1.0 + sd * uniform(random));
+        const double low    = std::min(open, price) * (1.0 - sd * uniform(random));
+        const double volume = std::floor(1000.0 + 99000.0 * uniform(random));
+
+        if (i != 0 && i + 1 != times.size() && uniform(random) < options.missing) continue;
+
+        bars.push_back(static_cast<std::size_t>(times[i]), open, high, low, price, price, volume);
+    }
+}
+
+} // namespace detail
+
+/*
+
+Writes <year>.sft files of synthetic tickers into `directory`. Tickers are
+generated in parallel and streamed through Writer in order, a batch at a
+time; Writer spills the rollups to disk, so memory stays bounded by the batch
+no matter how large the files get.
+Output only depends on the options and the seed, not on the thread count.
+
+*/
+SyntheticResult
+generateSynthetic(const std::string& directory, const SyntheticOptions& options = {})
+{
+    using namespace detail;
+
+    SyntheticResult result;
+    const auto threads = std::max<std::size_t>(options.threads, 1);
+    const auto exchange_count = std::max<std::size_t>(options.exchanges, 1);
+    const auto interval = std::max<int64_t>(options.interval, 1);
+
+    char name[64];
+    std::vector<util::id_t> exchanges, companies;
+    for (std::size_t e = 0; e < exchange_count; e++)
+    {
+        std::snprintf(name, sizeof(name), "SYN%zu", e);
+        if (!util::Universe::exists(name))
+        {
+            auto exchange = Exchange::makeNamed(name);
+            exchange->name    = name;
+            exchange->country = "Nowhere";
+            exchange->city    = "Nowhere";
+        }
+        exchanges.push_back(util::Universe::getID(name));
+    }
+
+    for (std::size_t c = 0; c < options.tickers; c++)
+    {
+        std::snprintf(name, sizeof(name), "Synthetic %05zu", c);
+        const auto ticker = "S" + std::string(name + 10);
+        if (!util::Universe::exists(ticker))
+        {
+            auto company = Company::makeNamed(ticker, exchanges[c % exchange_count]);
+            company->name   = name;
+            company->ticker = ticker;
+        }
+        companies.push_back(util::Universe::getID(ticker));
+    }
+
+    const auto calendar = Calendar::nyse();
+    std::vector<double> prices(options.tickers, 100.0);
+
+    for (std::size_t y = 0; y < options.years; y++)
+    {
+        const auto year  = options.first_year + static_cast<int32_t>(y);
+        const auto start = daysFromCivil(year, 1, 1) * 86400;
+        const auto end   = daysFromCivil(year + 1, 1, 1) * 86400;
+
+        std::vector<int64_t> times;
+        for (auto t = start; t < end; t += interval)
+            if (!options.sessions || calendar.isOpen(t))
+                times.push_back(t);
+
+        if (times.empty()) continue;
+
+        std::vector<double> market(times.size());
+        {
+            std::mt19937_64 random(splitmix(options.seed ^ static_cast<uint64_t>(year)));
+            std::normal_distribution<double> normal;
+            for (auto& m : market) m = normal(random);
+        }
+
+        const auto filename = directory + "/" + std::to_string(year) + ".sft";
+        Writer writer(filename, exchanges, companies, options.rollups, options.prices);
+
+        const auto batch = threads * 4;
+        std::vector<Bars> slots(std::min(batch, options.tickers));
+
+        for (std::size_t first = 0; first < options.tickers; first += batch)
+        {
+            const auto count = std::min(batch, options.tickers - first);
+
+            std::atomic<std::size_t> next = 0;
+            std::vector<std::thread> workers;
+            for (std::size_t t = 0; t < std::min(threads, count); t++)
+                workers.emplace_back([&]()
+                {
+                    for (auto i = next++; i < count; i = next++)
+                    {
+                        const auto c = first + i;
+                        const auto seed = splitmix(options.seed ^ splitmix(c * 0x100000001b3ull + static_cast<uint64_t>(year)));
+                        syntheticBars(options, times, market, seed, prices[c], slots[i]);
+                    }
+                });
+            for (auto& w : workers) w.join();
+
+            for (std::size_t i = 0; i < count; i++)
+            {
+                result.bars += slots[i].size();
+                writer.write(slots[i]);
+            }
+        }
+
+        writer.close();
+        result.files.push_back(filename);
+    }
+
+    return result;
+}
+
+}
@@ -0,0 +1,384 @@
+#pragma once
+
+#include <queue>
+
+#include <sfl/def.hpp>
+#include <sfl/util/Memory.hpp>
+#include <sfl/util/Time.hpp>
+
+#include "Objects.hpp"
+#include "Bars.hpp"
+#include "File.hpp"
+
+namespace sfl
+{
+
+/*
+
+One trade or quote update. Times are nanoseconds since the epoch (bars are
+in seconds). Trades have a size; quote updates have a size of 0 and only
+change the bid and ask, so their price is ignored when building bars.
+
+*/
+struct Tick
+{
+    int64_t time;
+    double  price;
+    double  size;
+    double  bid, ask;
+
+    bool trade() const { return size > 0.0; }
+};
+
+constexpr int64_t nanoseconds_per_second = 1'000'000'000;
+
+// Allocations of every tick segment
+struct TickMemory
+{
+    static util::memory::Account& account()
+    {
+        static util::memory::Account& a = util::memory::registry().add("Tick segments");
+        return a;
+    }
+};
+
+/*
+
+A fixed capacity chunk of one company's ticks, a column per field. The
+columns are reserved up front and never grow, so appending is a bounds
+check and five stores, and a full segment is never touched again.
+
+*/
+struct TickSegment
+{
+    template<typename T>
+    using Column = std::vector<T, util::memory::Allocator<T, TickMemory>>;
+
+    TickSegment(std::size_t _capacity) :
+        capacity(_capacity)
+    {
+        time.reserve(capacity);
+        price.reserve(capacity);
+        size.reserve(capacity);
+        bid.reserve(capacity);
+        ask.reserve(capacity);
+    }
+
+    bool full() const { return time.size() == capacity; }
+    std::size_t count() const { return time.size(); }
+
+    void push_back(const Tick& t)
+    {
+        time.push_back(t.time);
+        price.push_back(t.price);
+        size.push_back(t.size);
+        bid.push_back(t.bid);
+        ask.push_back(t.ask);
+    }
+
+    Tick operator[](std::size_t i) const
+    {
+        return Tick{ time[i], price[i], size[i], bid[i], ask[i] };
+    }
+
+    Column<int64_t> time;
+    Column<double>  price, size, bid, ask;
+    std::size_t capacity;
+};
+
+/*
+
+Every tick of one company, in time order, as a list of segments. Segments
+start small and double up to max_segment, so thinly traded companies don't
+hold megabytes of empty columns. A series has a single writer.
+
+*/
+struct TickSeries
+{
+    static constexpr std::size_t min_segment = 1 << 10;
+    static constexpr std::size_t max_segment = 1 << 16;
+
+    void append(const Tick& t)
+    {
+        assert(!ticks || t.time >= last());
+        if (segments.empty() || segments.back().full())
+            segments.emplace_back(segments.empty() ? min_segment : std::min(segments.back().capacity * 2, max_segment));
+
+        segments.back().push_back(t);
+        ticks++;
+    }
+
+    void append(std::span<const Tick> batch)
+    {
+        for (const auto& t : batch) append(t);
+    }
+
+    std::size_t size() const { return ticks; }
+    bool empty() const { return ticks == 0; }
+
+    int64_t first() const { return segments.front().time.front(); }
+    int64_t last()  const { return segments.back().time.back(); }
+
+    // Position of the first tick at or after `time`, as (segment, index)
+    std::pair<std::size_t, std::size_t> seek(int64_t time) const
+    {
+        const auto s = std::partition_point(segments.begin(), segments.end(),
+            [&](const TickSegment& segment) { return segment.time.back() < time; });
+        if (s == segments.end()) return { segments.size(), 0 };
+
+        const auto i = std::lower_bound(s->time.begin(), s->time.end(), time);
+        return { static_cast<std::size_t>(std::distance(segments.begin(), s)), static_cast<std::size_t>(std::distance(s->time.begin(), i)) };
+    }
+
+    // Calls f(tick) for every tick with from <= time < to
+    template<typename F>
+    void each(int64_t from, int64_t to, F&& f) const
+    {
+        for (auto [s, i] = seek(from); s < segments.size(); s++, i = 0)
+        {
+            const auto& segment = segments[s];
+            for (; i < segment.count(); i++)
+            {
+                if (segment.time[i] >= to) return;
+                f(segment[i]);
+            }
+        }
+    }
+
+    std::size_t footprint() const
+    {
+        std::size_t bytes = segments.capacity() * sizeof(TickSegment);
+        for (const auto& s : segments)
+            bytes += s.capacity * (sizeof(int64_t) + sizeof(double) * 4);
+        return bytes;
+    }
+
+    std::vector<TickSegment> segments;
+
+private:
+    std::size_t ticks = 0;
+};
+
+/*
+
+Builds bars of `interval` seconds from a stream of ticks in time order, the
+way Bars::rollup builds them from bars: the first trade opens, the last one
+closes (and is the last), volume is the traded size. A bar is stamped with
+the start of its interval and completes when the first trade of a later
+interval arrives, or on flush(). Intervals without trades get no bar.
+
+*/
+struct BarAggregator
+{
+    BarAggregator(int64_t _interval) :
+        interval(_interval * nanoseconds_per_second)
+    {
+        assert(_interval > 0);
+    }
+
+    void add(const Tick& t)
+    {
+        if (!t.trade()) return;
+
+        const auto bucket = floorDiv(t.time, interval);
+        if (!open || bucket != current)
+        {
+            if (open) complete();
+
+            open    = true;
+            current = bucket;
+            o = h = l = c = t.price;
+            v = t.size;
+            return;
+        }
+
+        h  = std::max(h, t.price);
+        l  = std::min(l, t.price);
+        c  = t.price;
+        v += t.size;
+    }
+
+    void add(std::span<const Tick> ticks)
+    {
+        for (const auto& t : ticks) add(t);
+    }
+
+    // Completes the bar in progress
+    void flush()
+    {
+        if (open) complete();
+        open = false;
+    }
+
+    // completed bars, the caller may take or clear them at any time
+    Bars bars;
+
+    // called with every completed bar, after it has been added to `bars`
+    std::function<void(const Bars&)> completed;
+
+private:
+    void complete()
+    {
+        const auto time = static_cast<std::size_t>(current * (interval / nanoseconds_per_second));
+        bars.push_back(time, o, h, l, c, c, v);
+        if (completed) completed(bars);
+    }
+
+    int64_t interval; // ns
+    int64_t current = 0;
+    bool    open    = false;
+    double  o = 0, h = 0, l = 0, c = 0, v = 0;
+};
+
+/*
+
+Ticks of many companies. Appending goes straight to a company's series, so
+the hot path holds on to the TickSeries& from series() instead of looking
+the company up per tick. Different series can be appended to from
+different threads; creating series cannot.
+
+*/
+struct TickStore
+{
+    TickSeries& series(const util::id_t& company)
+    {
+        const auto it = map.find(company);
+        if (it != map.end()) return it->second;
+
+        order.push_back(company);
+        return map[company];
+    }
+
+    const TickSeries* find(const util::id_t& company) const
+    {
+        const auto it = map.find(company);
+        return (it == map.end() ? nullptr : &it->second);
+    }
+
+    void append(const util::id_t& company, const Tick& t) { series(company).append(t); }
+
+    // companies in the order their first tick arrived
+    const std::vector<util::id_t>& companies() const { return order; }
+
+    std::size_t size() const
+    {
+        std::size_t n = 0;
+        for (const auto& p : map) n += p.second.size();
+        return n;
+    }
+
+    // Bars of `interval` seconds of one company
+    Bars bars(const util::id_t& company, int64_t interval) const
+    {
+        BarAggregator aggregator(interval);
+        if (const auto* s = find(company))
+            for (const auto& segment : s->segments)
+                for (std::size_t i = 0; i < segment.count(); i++)
+                    aggregator.add(segment[i]);
+
+        aggregator.flush();
+        return std::move(aggregator.bars);
+    }
+
+    // Adds every company with trades, its exchange and its bars of `interval` seconds to a file
+    void addBars(File& file, int64_t interval) const
+    {
+        for (const auto& company : order)
+        {
+            // companies with only quote updates have no bars
+            auto b = bars(company, interval);
+            if (b.empty()) continue;
+
+            if (std::find(file.companies.begin(), file.companies.end(), company) == file.companies.end())
+                file.companies.push_back(company);
+
+            const auto exchange = Company::get(company)->exchangeID();
+            if (std::find(file.exchanges.begin(), file.exchanges.end(), exchange) == file.exchanges.end())
+                file.exchanges.push_back(exchange);
+
+            file.addDatapoints(company, b);
+        }
+    }
+
+    std::size_t footprint() const
+    {
+        std::size_t bytes = order.capacity() * sizeof(util::id_t) + map.bucket_count() * sizeof(void*);
+        for (const auto& p : map)
+            bytes += sizeof(void*) + sizeof(p) + p.second.footprint();
+        return bytes;
+    }
+
+private:
+    std::unordered_map<util::id_t, TickSeries> map;
+    std::vector<util::id_t> order;
+};
+
+/*
+
+Replays the ticks of every company of a store as one stream in time order,
+merging the series with a heap of cursors. Ticks of the same time come in
+the order the companies were added to the store.
+
+*/
+struct TickReplay
+{
+    TickReplay(const TickStore& store, int64_t from = std::numeric_limits<int64_t>::min())
+    {
+        const auto& companies = store.companies();
+        for (uint32_t rank = 0; rank < companies.size(); rank++)
+        {
+            const auto* s = store.find(companies[rank]);
+            const auto [segment, index] = s->seek(from);
+
+            Cursor c{ companies[rank], s, segment, index, rank };
+            if (c.valid()) heap.push(c);
+        }
+    }
+
+    // Calls f(company, tick) for every tick before `until`, in time order
+    template<typename F>
+    void advance(int64_t until, F&& f)
+    {
+        while (!heap.empty() && heap.top().time() < until)
+        {
+            auto c = heap.top();
+            heap.pop();
+
+            f(c.company, c.series->segments[c.segment][c.index]);
+
+            if (++c.index == c.series->segments[c.segment].count())
+            {
+                c.segment++;
+                c.index = 0;
+            }
+            if (c.valid()) heap.push(c);
+        }
+    }
+
+    bool done() const { return heap.empty(); }
+
+private:
+    struct Cursor
+    {
+        util::id_t company;
+        const TickSeries* series;
+        std::size_t segment, index;
+        uint32_t rank;
+
+        bool valid() const { return segment < series->segments.size() && index < series->segments[segment].count(); }
+        int64_t time() const { return series->segments[segment].time[index]; }
+    };
+
+    struct Later
+    {
+        bool operator()(const Cursor& a, const Cursor& b) const
+        {
+            const auto ta = a.time(), tb = b.time();
+            return (ta != tb ? ta > tb : a.rank > b.rank);
+        }
+    };
+
+    std::priority_queue<Cursor, std::vector<Cursor>, Later> heap;
+};
+
+}
@@ -6,6 +6,9 @@
 #include <algorithm>
 #include <vector>
 #include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <optional>
 #include <ctime>
 #include <fstream>
 #include <unordered_map>
@@ -16,7 +19,7 @@
 
 namespace sfl
 {
-    #define FILE_VERSION 1
+    #define FILE_VERSION 3
     using index_type = uint32_t;
     using id_t = util::id_t;
 }
\ No newline at end of file
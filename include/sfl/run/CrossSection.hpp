@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cmath>
+
+#include <sfl/def.hpp>
+#include <sfl/util/Simd.hpp>
+
+#include "Panel.hpp"
+
+namespace sfl
+{
+
+/*
+
+Cross-sectional operations over one row of a panel. All scratch space is
+sized to the panel width on construction, so nothing allocates per stop.
+Returned spans point into that scratch space and stay valid until the same
+operation is called again. Whatever the panel's price representation, the
+values computed from it are doubles.
+
+*/
+template<typename P = DoublePrice>
+struct BasicCrossSection
+{
+    BasicCrossSection(const BasicPanel<P>& _panel) :
+        panel(_panel),
+        values(_panel.width()),
+        normalized(_panel.width()),
+        ranks(_panel.width()),
+        grouped(_panel.width()),
+        order(_panel.width()),
+        selected(_panel.width()),
+        group_sums(_panel.exchanges.size()),
+        group_counts(_panel.exchanges.size())
+    {   }
+
+    // Simple returns of every column between row - lag and row
+    std::span<const double> returns(std::size_t row, std::size_t lag = 1)
+    {
+        assert(row >= lag);
+        const auto now  = panel.row(row);
+        const auto then = panel.row(row - lag);
+
+        double* out = values.data();
+        for (std::size_t i = 0; i < now.size(); i++)
+            out[i] = P::decode(now[i]) / P::decode(then[i]) - 1.0;
+
+        return values;
+    }
+
+    std::span<const double> zscore(std::span<const double> in)
+    {
+        assert(in.size() <= normalized.size());
+        const auto n = in.size();
+        if (!n) return {};
+
+        const double mean = util::sum(in.data(), n) / static_cast<double>(n);
+        const double sd   = std::sqrt(util::squares(in.data(), n, mean) / static_cast<double>(n));
+        const double inv  = (sd > 0.0 ? 1.0 / sd : 0.0);
+
+        double* out = normalized.data();
+        for (std::size_t i = 0; i < n; i++)
+            out[i] = (in[i] - mean) * inv;
+
+        return std::span<const double>(normalized.data(), n);
+    }
+
+    // Ranks scaled to [0, 1], the largest value ranks 1
+    std::span<const double> rank(std::span<const double> in)
+    {
+        assert(in.size() <= ranks.size());
+        const auto n = in.size();
+        if (!n) return {};
+
+        fill_order(n);
+        std::sort(order.begin(), order.begin() + n, [&](uint32_t a, uint32_t b) { return in[a] < in[b]; });
+
+        const double scale = (n > 1 ? 1.0 / static_cast<double>(n - 1) : 0.0);
+        for (std::size_t i = 0; i < n; i++)
+            ranks[order[i]] = static_cast<double>(i) * scale;
+
+        return std::span<const double>(ranks.data(), n);
+    }
+
+    // Columns of the k largest values, largest first. Only the k selected are sorted.
+    std::span<const uint32_t> top(std::span<const double> in, std::size_t k)
+    {
+        return select(in, k, [&](uint32_t a, uint32_t b) { return in[a] > in[b]; });
+    }
+
+    // Columns of the k smallest values, smallest first
+    std::span<const uint32_t> bottom(std::span<const double> in, std::size_t k)
+    {
+        return select(in, k, [&](uint32_t a, uint32_t b) { return in[a] < in[b]; });
+    }
+
+    // Mean of the values of each exchange, indexed by panel group
+    std::span<const double> groupMean(std::span<const double> in)
+    {
+        assert(in.size() == panel.width());
+        std::fill(group_sums.begin(), group_sums.end(), 0.0);
+        std::fill(group_counts.begin(), group_counts.end(), 0);
+
+        for (std::size_t i = 0; i < in.size(); i++)
+        {
+            group_sums[panel.groups[i]] += in[i];
+            group_counts[panel.groups[i]]++;
+        }
+
+        for (std::size_t g = 0; g < group_sums.size(); g++)
+            group_sums[g] /= static_cast<double>(std::max<uint32_t>(group_counts[g], 1));
+
+        return group_sums;
+    }
+
+    // Values minus the mean of their exchange
+    std::span<const double> demean(std::span<const double> in)
+    {
+        const auto means = groupMean(in);
+        for (std::size_t i = 0; i < in.size(); i++)
+            grouped[i] = in[i] - means[panel.groups[i]];
+
+        return std::span<const double>(grouped.data(), in.size());
+    }
+
+private:
+    void fill_order(std::size_t n)
+    {
+        for (uint32_t i = 0; i < n; i++) order[i] = i;
+    }
+
+    template<typename Compare>
+    std::span<const uint32_t> select(std::span<const double> in, std::size_t k, Compare comp)
+    {
+        assert(in.size() <= order.size());
+        const auto n = in.size();
+        k = std::min(k, n);
+        if (!k) return {};
+
+        fill_order(n);
+        std::nth_element(order.begin(), order.begin() + (k - 1), order.begin() + n, comp);
+        std::sort(order.begin(), order.begin() + k, comp);
+        std::copy(order.begin(), order.begin() + k, selected.begin());
+
+        return std::span<const uint32_t>(selected.data(), k);
+    }
+
+    const BasicPanel<P>& panel;
+
+    std::vector<double>   values, normalized, ranks, grouped;
+    std::vector<uint32_t> order, selected;
+    std::vector<double>   group_sums;
+    std::vector<uint32_t> group_counts;
+};
+
+using CrossSection = BasicCrossSection<DoublePrice>;
+
+}
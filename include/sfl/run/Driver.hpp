@@ -4,136 +4,111 @@
 
 #include <sfl/def.hpp>
 #include <sfl/data/Objects.hpp>
+#include <sfl/data/File.hpp>
+#include <sfl/data/TickStore.hpp>
 
+#include <sfl/util/MappedFile.hpp>
 #include <sfl/util/Time.hpp>
+#include <sfl/util/Trace.hpp>
+
+#include "Stop.hpp"
+#include "Panel.hpp"
+#include "CrossSection.hpp"
+#include "Portfolio.hpp"
+#include "Execution.hpp"
+#include "Metrics.hpp"
+#include "Results.hpp"
 
 namespace sfl
 {
 
-struct Timepoint
-{
-    time_t time;
-    double price;
-    //util::id_t datapoint;
-};
+/*
 
-struct Stop
-{
-    std::size_t time;
-    std::unordered_map<util::id_t, Timepoint> points;
-    //std::vector<Timepoint> points;
-};  
+Base of every strategy. P is the price representation of the panel the
+strategy sees (see Price.hpp), the driver builds its panel to match:
 
-struct Portfolio
+    struct Compact : BasicStrategy<FloatPrice> { ... };
+
+*/
+template<typename P = DoublePrice>
+struct BasicStrategy
 {
-    struct Event
-    {
-        enum Type
-        {
-            Buy, Sell
-        } type;
-        Timepoint timepoint;
-        util::id_t company;
-    };
+    using price_type = P;
+
+    Portfolio portfolio;
+    std::span<const Stop> history;
+    Stop current_stop;
+
+    // dense view of every stop, current_stop is row `row`
+    const BasicPanel<P>* panel = nullptr;
+    std::size_t row = 0;
+
+    std::span<const typename P::value_type> prices() const { return panel->row(row); }
 
-    double principal;
-    std::unordered_map<util::id_t, uint32_t> owned_stocks;
-    std::vector<Event> events;
+    // price of a column at the current stop as a double
+    double price(std::size_t column) const { return panel->price(row, column); }
 
-    double profit(const Stop& current_stop) const
+    Execution execution;
+
+    // Orders are queued with the execution simulator and filled against the next stop.
+    // Each call returns the order id, or 0 if the order was refused outright.
+    Order::id_type buy(const util::id_t& company_id, int64_t quantity = 1)
     {
-        double v = 0.0;
-        for (const auto& e : events)
-            v += (current_stop.points.at(e.company).price - e.timepoint.price) * (e.type == Event::Buy ? 1.0 : -1.0);
-        return v;
+        return submit(company_id, Order::Buy, Order::Type::Market, quantity);
     }
 
-    double value(const Stop& current_stop) const
+    Order::id_type sell(const util::id_t& company_id, int64_t quantity = 1)
     {
-        double v = principal;
-        for (const auto& e : events)
-            v += e.timepoint.price * (e.type == Event::Buy ? 1.0 : -1.0);
-        return v + profit(current_stop);
+        return submit(company_id, Order::Sell, Order::Type::Market, quantity);
     }
-};
-
-struct Stock
-{
-    util::id_t company;
-    double current_value;
-    Timepoint bought;
-};
-
-struct BaseStrategy
-{
-    //Portfolio portfolio;
-    double principal;
-    std::vector<Stock> owned;
-    std::span<const Stop> history;
-    Stop current_stop;
 
-    bool buy(const util::id_t& company_id)
+    Order::id_type buyLimit(const util::id_t& company_id, int64_t quantity, double limit)
     {
-        if (!current_stop.points.count(company_id))
-            return false;
-
-        const auto& timepoint = current_stop.points[company_id];
-        if (principal < timepoint.price)
-            return false;
-
-        principal -= timepoint.price;
-        owned.push_back(Stock{
-            .bought = timepoint,
-            .company = company_id,
-            .current_value = timepoint.price
-        });
-
-        return true;
+        return submit(company_id, Order::Buy, Order::Type::Limit, quantity, limit);
     }
 
-    bool sell(std::vector<Stock>::iterator stock)
+    Order::id_type sellLimit(const util::id_t& company_id, int64_t quantity, double limit)
     {
-        principal += stock->current_value;
-        owned.erase(stock);
-        return true;
+        return submit(company_id, Order::Sell, Order::Type::Limit, quantity, limit);
     }
 
-    /*
-    bool buy(const util::id_t& company_id)
+    Order::id_type buyStop(const util::id_t& company_id, int64_t quantity, double stop, std::optional<double> limit = std::nullopt)
     {
-        if (!current_stop.points.count(company_id) ||
-             portfolio.principal < current_stop.points[company_id].price)
-                return false;
-
-        portfolio.owned_stocks[company_id]++;
-        portfolio.principal -= current_stop.points[company_id].price;
-        portfolio.events.push_back(Portfolio::Event {
-            .type = Portfolio::Event::Buy,
-            .timepoint = current_stop.points[company_id],
-            .company = company_id
-        });
+        return submit(company_id, Order::Buy, (limit ? Order::Type::StopLimit : Order::Type::Stop), quantity, limit.value_or(0.0), stop);
+    }
 
-        return true;
+    Order::id_type sellStop(const util::id_t& company_id, int64_t quantity, double stop, std::optional<double> limit = std::nullopt)
+    {
+        return submit(company_id, Order::Sell, (limit ? Order::Type::StopLimit : Order::Type::Stop), quantity, limit.value_or(0.0), stop);
     }
 
-    bool sell(const util::id_t& company_id)
+    bool cancel(Order::id_type order) { return execution.cancel(order); }
+
+    Order::id_type submit(const util::id_t& company_id, Order::Side side, Order::Type type, int64_t quantity, double limit = 0.0, double stop = 0.0)
     {
-        if (!current_stop.points.count(company_id) ||
-            !portfolio.owned_stocks.count(company_id) ||
-            !portfolio.owned_stocks[company_id] ||
-            portfolio.principal < current_stop.points[company_id].price)
-            return false;
-
-        portfolio.owned_stocks[company_id]--;
-        portfolio.principal += current_stop.points[company_id].price;
-        portfolio.events.push_back(Portfolio::Event {
-            .type = Portfolio::Event::Sell,
-            .timepoint = current_stop.points[company_id],
-            .company = company_id
+        if (!current_stop.points.count(company_id) || quantity <= 0)
+            return 0;
+
+        if (side == Order::Sell && !execution.allow_short && portfolio.quantity(company_id) < quantity)
+            return 0;
+
+        return execution.submit(Order {
+            .company  = company_id,
+            .side     = side,
+            .type     = type,
+            .quantity = quantity,
+            .limit    = limit,
+            .stop     = stop,
+            .placed   = current_stop.time
         });
+    }
+
+    virtual void filled(const Fill& fill) {}
 
-        return true;
-    }*/
+    // Every tick of the next stop's bar, when the driver has ticks, called before that stop's step()
+    // while the current stop is still the previous one. Orders placed here are matched against the
+    // stop after the bar, since the bar itself already traded through them.
+    virtual void tick(const util::id_t& company, const Tick& tick) {}
 
     virtual void start() {}
     virtual void stop()  {}
@@ -141,13 +116,80 @@ struct BaseStrategy
     virtual void step() = 0;
 };
 
+using BaseStrategy = BasicStrategy<DoublePrice>;
+
+// Allocations of the alignment buffers in Driver::run
+struct AlignmentMemory
+{
+    static util::memory::Account& account()
+    {
+        static util::memory::Account& a = util::memory::registry().add("Driver alignment");
+        return a;
+    }
+};
+
+/*
+
+Memory of the last Driver::run, in bytes. Universe objects, stops and the
+alignment buffers are tracked as they are allocated; the file's id tables,
+the panel, the equity curve and the strategy are measured at the end of the
+run. The peak is the most tracked memory held at any point of the run plus
+the measured parts.
+
+*/
+struct Footprint
+{
+    std::size_t universe = 0, file = 0, stops = 0, panel = 0, equity = 0, strategy = 0;
+    std::size_t peak = 0;
+};
+
+inline std::ostream& operator<<(std::ostream& os, const Footprint& f)
+{
+    const auto mib = [](std::size_t bytes) { return static_cast<double>(bytes) / (1 << 20); };
+
+    char line[96];
+    const auto row = [&](const char* name, std::size_t bytes)
+    {
+        std::snprintf(line, sizeof(line), "%-10s %12.2f MiB\n", name, mib(bytes));
+        os << line;
+    };
+
+    row("universe", f.universe);
+    row("file",     f.file);
+    row("stops",    f.stops);
+    row("panel",    f.panel);
+    row("equity",   f.equity);
+    row("strategy", f.strategy);
+    row("peak",     f.peak);
+    return os;
+}
+
 template<class T, class U>
 concept Derived = std::is_base_of<U, T>::value;
 
 template<typename T>
-concept Strategy = Derived<T, BaseStrategy>;
+concept Strategy = Derived<T, BasicStrategy<typename T::price_type>>;
 
-template<Strategy S>
+// Bar interval a strategy trades on, in seconds
+struct Resolution
+{
+    int64_t seconds = 0;
+};
+
+/*
+
+Time slices of an out-of-core run, see Driver::runSliced. At least one stop
+is carried over, so row 0 is only ever the first stop of the run.
+
+*/
+struct Slices
+{
+    int64_t seconds = 0;       // of timeline per slice
+    std::size_t lookback = 1;  // stops of the previous slice kept in front of the next one
+    int64_t interval = 0;      // as Resolution, bars from the coarsest rollup that divides it
+};
+
+template<Strategy S, typename Sink = NullSink>
 struct Driver
 {
     template<typename... Args>
@@ -155,21 +197,108 @@ struct Driver
     {
         strategy = std::make_unique<S>(std::forward<Args>(args)...);
         file.load(filename);
+    }
 
-        for (const auto& p : file.datapoints)
-            timeseries[p.first].resize(p.second.size());
+    // Runs on the coarsest rollup stored in the file that divides the resolution, see File::load
+    template<typename... Args>
+    Driver(const std::string& filename, Resolution resolution, Args&&... args)
+    {
+        strategy = std::make_unique<S>(std::forward<Args>(args)...);
+        file.load(filename, resolution.seconds);
+    }
+
+    // Streams the file a slice at a time instead of loading it
+    template<typename... Args>
+    Driver(const std::string& filename, Slices _slices, Args&&... args) :
+        source(filename),
+        slices(_slices)
+    {
+        assert(slices.seconds > 0 && slices.lookback >= 1);
+        strategy = std::make_unique<S>(std::forward<Args>(args)...);
+    }
+
+    // Runs on bars of the resolution built from the ticks, and feeds the ticks themselves to the strategy
+    template<typename... Args>
+    Driver(const TickStore& store, Resolution resolution, Args&&... args) :
+        ticks(&store)
+    {
+        strategy = std::make_unique<S>(std::forward<Args>(args)...);
+        store.addBars(file, resolution.seconds);
+        file.resolution = resolution.seconds;
     }
 
     void run()
+    {
+        SFL_TRACE_SCOPE("driver.run");
+
+        auto& tracked = util::memory::registry().total;
+        tracked.resetPeak();
+
+        if (slices.seconds)
+        {
+            runSliced();
+            return;
+        }
+
+        std::vector<util::id_t> companies;
+        const auto stops = align(companies);
+
+        // no bars at all, or no overlap between the series
+        if (stops.empty())
+        {
+            equity.clear();
+            metrics.clear();
+            sink.flush();
+            measure(file.footprint(), 0);
+            return;
+        }
+
+        {
+            SFL_TRACE_SCOPE("driver.panel");
+            panel.build(companies, stops);
+        }
+        strategy->panel = &panel;
+
+        equity.clear();
+        equity.reserve(stops.size());
+        metrics.clear();
+
+        std::optional<TickReplay> replay;
+        if (ticks) replay.emplace(*ticks, static_cast<int64_t>(stops.front().time) * nanoseconds_per_second);
+
+        for (std::size_t i = 0; i < stops.size(); i++)
+            play(stops, i, replay);
+
+        sink.flush();
+        measure(file.footprint(), panel.footprint());
+    }
+
+    using Stops = std::vector<Stop, util::memory::Allocator<Stop, StopMemory>>;
+
+    /*
+
+    The stops of a run over the loaded file: every bar time between the
+    latest first bar and the earliest last bar, with a company missing at a
+    stop interpolated between its bars on either side. `companies` gets the
+    companies with bars, the panel's columns. Empty when the series don't
+    overlap. run() starts with it; it's public so its cost can be measured
+    on its own.
+
+    */
+    Stops align(std::vector<util::id_t>& companies)
     {
         // time series will (in general) not have the same amount of points
         // so we need to take the one with the largest amount (as this is the finest grain resolution)
 
+        [[maybe_unused]] const auto align_begin = SFL_TRACE_NOW();
+
         // find the latest first time and the earliest last time
         std::size_t lastest_time  = std::numeric_limits<std::size_t>::min();
         std::size_t earliest_time = std::numeric_limits<std::size_t>::max();
         for (const auto& p : file.datapoints)
         {
+            if (p.second.empty()) continue;
+
             const auto earliest = Datapoint::get(p.second.front())->time;
             const auto latest = Datapoint::get(p.second.back())->time;
 
@@ -179,28 +308,36 @@ struct Driver
 
         // gather all of the time points
         using id_index_pair = std::pair<util::id_t, std::size_t>;
+        using id_index_pairs = std::vector<id_index_pair, util::memory::Allocator<id_index_pair, AlignmentMemory>>;
 
-        std::vector<id_index_pair> times;
-        for (const auto& p : timeseries)
+        id_index_pairs times;
+        for (const auto& p : file.datapoints)
         {
             std::size_t index = 0;
-            for (const auto& id : file.datapoints[p.first])
+            for (const auto& id : p.second)
             {
                 auto d = Datapoint::get(id);
-                if (d->time >= lastest_time && d->time <= earliest_time)
+                if (d->time >= lastest_time && d->time <= earliest_time &&
+                    (!calendar || calendar->isOpen(static_cast<int64_t>(d->time))))
                     times.push_back(std::pair(id, index));
 
                 index++;
             }
         }
 
+        // no bars at all, or no overlap between the series
+        if (times.empty()) return {};
+
         // sort it by time
-        std::sort(times.begin(), times.end(), [](auto a, auto b) { return Datapoint::get(a.first)->time < Datapoint::get(b.first)->time; });
+        {
+            SFL_TRACE_SCOPE("driver.sort");
+            std::sort(times.begin(), times.end(), [](auto a, auto b) { return Datapoint::get(a.first)->time < Datapoint::get(b.first)->time; });
+        }
 
         auto current_time = Datapoint::get(times[0].first)->time;
-        std::vector<std::vector<id_index_pair>> groups(1);
+        std::vector<id_index_pairs, util::memory::Allocator<id_index_pairs, AlignmentMemory>> groups(1);
         
-        std::vector<id_index_pair>* current = &groups[0];
+        id_index_pairs* current = &groups[0];
 
         uint32_t index = 1;
         for (const auto& time : times)
@@ -209,14 +346,27 @@ struct Driver
             if (d->time > current_time) 
             {
                 current_time = d->time;
-                groups.push_back(std::vector<id_index_pair>());
+                groups.push_back(id_index_pairs());
                 current = &groups[index++];
             }
 
             current->push_back(time);
         }
 
-        std::vector<Stop> stops(groups.size());
+        // companies without bars (an empty section) get no column and are never interpolated
+        companies.clear();
+        for (const auto& c : file.companies)
+        {
+            const auto it = file.datapoints.find(c);
+            if (it != file.datapoints.end() && !it->second.empty())
+                companies.push_back(c);
+        }
+
+        SFL_TRACE_COMPLETE("driver.align", align_begin);
+        [[maybe_unused]] const auto interpolate_begin = SFL_TRACE_NOW();
+        [[maybe_unused]] std::size_t interpolated = 0;
+
+        Stops stops(groups.size());
 
         std::size_t i = 0;
         for (const auto& g : groups)
@@ -226,14 +376,11 @@ struct Driver
 
             const auto left_over = [&]() -> std::set<util::id_t>
             {
-                std::set<util::id_t> companies;
-                for (const auto& c : file.companies)
-                    companies.insert(c);
-
+                std::set<util::id_t> missing(companies.begin(), companies.end());
                 for (const auto& p : g)
-                    companies.erase(Datapoint::get(p.first)->companyID());
+                    missing.erase(Datapoint::get(p.first)->companyID());
                 
-                return companies;
+                return missing;
             }();
 
             for (const auto& p : g)
@@ -242,8 +389,13 @@ struct Driver
                 stops[i].points.insert(std::pair(
                     d->companyID(),
                     Timepoint {
+                        .time      = static_cast<time_t>(d->time),
                         .price     = (d->open + d->close) / 2.0,
-                        .time      = static_cast<time_t>(d->time)
+                        .open      = d->open,
+                        .high      = d->high,
+                        .low       = d->low,
+                        .close     = d->close,
+                        .volume    = d->volume
                     }
                 ));
             }
@@ -300,6 +452,7 @@ struct Driver
                 }
 
                 assert(a && b);
+                interpolated++;
 
                 auto d1 = Datapoint::get(*a);
                 auto d2 = Datapoint::get(*b);
@@ -311,13 +464,20 @@ struct Driver
                 
                 const auto price_a = (d1->open + d1->close) / 2.0;
                 const auto price_b = (d2->open + d2->close) / 2.0;
+                const auto price   = price_a * (1 - t) + t * price_b; // interpolation function
 
                 stops[i].points.insert(
                     std::pair(
                         d1->companyID(),
                         Timepoint {
-                            .price = price_a * (1 - t) + t * price_b, // interpolation function
-                            .time  = static_cast<time_t>(g_time)
+                            .time   = static_cast<time_t>(g_time),
+                            .price  = price,
+                            .open   = price,
+                            .high   = price,
+                            .low    = price,
+                            .close  = price,
+                            .volume = 0.0,
+                            .interpolated = true
                         }
                     )
                 );
@@ -327,24 +487,333 @@ struct Driver
             i++;
         }
 
-        // Go through each group and find the missing company and interpolate value
-        for (uint32_t i = 0; i < stops.size(); i++)
+        SFL_TRACE_COMPLETE("driver.interpolate", interpolate_begin);
+        SFL_TRACE_COUNTER("driver.stops", stops.size());
+        SFL_TRACE_COUNTER("driver.interpolated", interpolated);
+
+        return stops;
+    }
+
+    const EquityCurve& curve() const { return equity; }
+    Summary summary() const { return metrics.summary(); }
+    const Portfolio& portfolio() const { return strategy->portfolio; }
+    const Footprint& footprint() const { return usage; }
+
+    // interval of the bars driven, 0 when they are the file's stored bars
+    int64_t resolution() const { return file.resolution; }
+
+    Metrics metrics;
+    Sink sink;
+
+    // when set, bars outside the exchange's sessions never become stops
+    std::optional<Calendar> calendar;
+
+    // when set, the ticks of each stop's bar are fed to the strategy before its step, see BasicStrategy::tick
+    const TickStore* ticks = nullptr;
+
+private:
+    // One stop of a run: fills, the ticks of the stop's bar, marks, the strategy's step and the records
+    void play(std::span<const Stop> stops, std::size_t i, std::optional<TickReplay>& replay)
+    {
+        auto& portfolio = strategy->portfolio;
+
+        // orders placed up to the previous stop are matched against this stop's bars
+        {
+            SFL_TRACE_SCOPE("execution.match");
+            for (const auto& f : strategy->execution.match(stops[i], portfolio))
+            {
+                metrics.trade(f);
+                sink.fill(f);
+                strategy->filled(f);
+            }
+        }
+
+        // the ticks of this stop's bar, which is stamped with its start, seen from the previous stop
+        if (replay)
         {
-            strategy->history = std::span<const Stop>(stops.begin(), i);
-            strategy->current_stop = stops[i];
+            SFL_TRACE_SCOPE("driver.ticks");
+            const auto end = static_cast<int64_t>(stops[i].time) + file.resolution;
+            replay->advance(end * nanoseconds_per_second,
+                [&](const util::id_t& company, const Tick& t) { strategy->tick(company, t); });
+        }
+
+        strategy->history = stops.first(i);
+        strategy->current_stop = stops[i];
+        strategy->row = i;
 
-            for (Stock& s : strategy->owned)
-                s.current_value = stops[i].points[s.company].price;
+        // only the open positions need to be marked, not the whole stop
+        for (const auto& p : portfolio.positions)
+        {
+            const auto it = stops[i].points.find(p.first);
+            if (it != stops[i].points.end())
+                portfolio.mark(p.first, it->second.price);
+        }
 
+        {
+            SFL_TRACE_SCOPE("strategy.step");
             strategy->step();
         }
+
+        equity.record(stops[i].time, portfolio.cash, portfolio.market);
+        metrics.record(portfolio.value(), portfolio.market);
+        sink.equity(stops[i].time, portfolio.cash, portfolio.market);
     }
 
-private:
-    std::unordered_map<util::id_t, std::vector<Timepoint>> timeseries; // company, list
+    /*
+
+    Out-of-core run over the mapped file. The timeline, from the latest first
+    bar to the earliest last bar as in run(), is cut into slices of
+    `slices.seconds`. A slice decodes only its own bars of every section, plus
+    the bar on either side, so a company missing at a stop is interpolated
+    between the same two bars as in a full run even when they lie in other
+    slices. Only the slice's stops and panel rows are built, behind the last
+    `slices.lookback` stops of the previous slice, and history and rows are
+    relative to that window. Peak memory is bounded by the slice and the
+    universe whatever the length of the file; only the equity curve still
+    grows with the number of stops.
+
+    */
+    void runSliced()
+    {
+        SFL_TRACE_SCOPE("driver.sliced");
+
+        FileIndex index;
+        [[maybe_unused]] const bool read = index.read(source);
+        assert(read);
+
+        util::MappedFile mapped(source);
+        assert(mapped);
+
+        visitPrice(index.prices, [&](auto policy)
+        {
+            runSliced<decltype(policy)>(index, mapped.view().data());
+        });
+    }
+
+    template<typename P>
+    void runSliced(const FileIndex& index, const char* data)
+    {
+        using Schema = BarSchema<P>;
+        constexpr auto time_field = static_cast<std::size_t>(BarField::Time);
+
+        // the universe objects, as File::load makes them
+        std::vector<util::id_t> exchanges;
+        for (const auto& e : index.exchanges)
+        {
+            auto d = Exchange::makeNamed(e.name);
+            d->name    = e.name;
+            d->country = e.country;
+            d->city    = e.city;
+            exchanges.push_back(d->getID());
+        }
+
+        struct Section
+        {
+            util::id_t  company;
+            const char* records;
+            std::size_t count;
+            std::size_t begin = 0; // first record not before the current slice
+            std::size_t next  = 0; // first bar of `bars` not before the current stop
+            BasicBars<P> bars;     // of the current slice, with one more on either side
+
+            std::size_t time(std::size_t i) const { return Schema::template read<time_field>(records + i * Schema::record_size); }
+
+            // first record from `i` on at or after `t`
+            std::size_t seek(std::size_t i, std::size_t t) const
+            {
+                std::size_t hi = count;
+                while (i < hi) { const auto mid = (i + hi) / 2; if (time(mid) < t) i = mid + 1; else hi = mid; }
+                return i;
+            }
+        };
+
+        // sections of the rollup level, when there is one, are read off the level's counts
+        const auto* level = (slices.interval ? detail::coarsest(index.rollups, slices.interval) : nullptr);
+        file.resolution = (level ? level->interval : 0);
+
+        std::vector<Section> sections;
+        std::vector<util::id_t> companies;
+        std::size_t position = (level ? level->offset : 0);
+        for (const auto& c : index.companies)
+        {
+            auto d = Company::makeNamed(companyKey(c.name, c.ticker), exchanges[c.exchange]);
+            d->name   = c.name;
+            d->ticker = c.ticker;
+
+            Section section{ .company = d->getID(), .records = data + c.offset, .count = c.count };
+            if (level)
+            {
+                section.count   = schema::load<std::size_t>(data + position);
+                section.records = data + position + sizeof(std::size_t);
+                position += sizeof(std::size_t) + section.count * Schema::record_size;
+            }
+
+            if (!section.count) continue;
+            companies.push_back(section.company);
+            sections.push_back(std::move(section));
+        }
+
+        if (sections.empty()) return;
+
+        // find the latest first time and the earliest last time
+        std::size_t window_begin = std::numeric_limits<std::size_t>::min();
+        std::size_t window_end   = std::numeric_limits<std::size_t>::max();
+        for (const auto& s : sections)
+        {
+            window_begin = std::max(window_begin, s.time(0));
+            window_end   = std::min(window_end,   s.time(s.count - 1));
+        }
+
+        equity.clear();
+        metrics.clear();
+
+        std::vector<std::size_t, util::memory::Allocator<std::size_t, AlignmentMemory>> times;
+        Stops stops;
+        std::optional<TickReplay> replay;
+        std::size_t bars_bytes = 0, panel_bytes = 0;
+
+        const auto step = static_cast<std::size_t>(slices.seconds);
+        for (std::size_t from = window_begin; from <= window_end; )
+        {
+            const auto to = std::min(from + step, window_end + 1);
+
+            // decode the slice, and gather the times of its stops
+            times.clear();
+            std::size_t slice_bytes = 0;
+            {
+                SFL_TRACE_SCOPE("driver.slice");
+                for (auto& s : sections)
+                {
+                    const auto lo = s.seek(s.begin, from);
+                    const auto hi = s.seek(lo, to);
+                    s.begin = hi;
+
+                    const auto first = (lo > 0 ? lo - 1 : 0);
+                    const auto last  = std::min(hi + 1, s.count);
+                    Schema::decode(s.records + first * Schema::record_size, last - first, s.bars);
+                    s.next = 0;
+
+                    for (std::size_t i = lo - first; i < hi - first; i++)
+                        if (!calendar || calendar->isOpen(static_cast<int64_t>(s.bars.time[i])))
+                            times.push_back(s.bars.time[i]);
+
+                    slice_bytes += s.bars.time.capacity() * sizeof(std::size_t) + s.bars.volume.capacity() * sizeof(typename P::volume_type)
+                                 + (s.bars.open.capacity() + s.bars.high.capacity() + s.bars.low.capacity()
+                                 +  s.bars.last.capacity() + s.bars.close.capacity()) * sizeof(typename P::value_type);
+                }
+            }
+            bars_bytes = std::max(bars_bytes, slice_bytes);
+
+            // slices in a gap of every section are skipped
+            std::size_t next = window_end + 1;
+            for (const auto& s : sections)
+                if (s.begin < s.count) next = std::min(next, s.time(s.begin));
+            from = (next >= to + step ? window_begin + (next - window_begin) / step * step : to);
+
+            std::sort(times.begin(), times.end());
+            times.erase(std::unique(times.begin(), times.end()), times.end());
+            if (times.empty()) continue;
+
+            // keep the lookback, then a stop per time with every company, actual or interpolated
+            if (stops.size() > slices.lookback)
+                stops.erase(stops.begin(), stops.end() - static_cast<std::ptrdiff_t>(slices.lookback));
+
+            const auto carried = stops.size();
+            stops.resize(carried + times.size());
+
+            for (std::size_t k = 0; k < times.size(); k++)
+            {
+                auto& stop = stops[carried + k];
+                stop.time = times[k];
+                stop.points.reserve(sections.size());
+
+                for (auto& s : sections)
+                {
+                    const auto& b = s.bars;
+                    while (s.next < b.time.size() && b.time[s.next] < stop.time) s.next++;
+                    assert(s.next < b.time.size());
+
+                    const auto mid = [&](std::size_t i) { return (P::decode(b.open[i]) + P::decode(b.close[i])) / 2.0; };
+
+                    if (b.time[s.next] == stop.time)
+                    {
+                        const auto i = s.next;
+                        stop.points.insert(std::pair(s.company, Timepoint {
+                            .time   = static_cast<time_t>(stop.time),
+                            .price  = mid(i),
+                            .open   = P::decode(b.open[i]),
+                            .high   = P::decode(b.high[i]),
+                            .low    = P::decode(b.low[i]),
+                            .close  = P::decode(b.close[i]),
+                            .volume = P::decodeVolume(b.volume[i])
+                        }));
+                        continue;
+                    }
+
+                    // between the bar before and the bar after, both decoded even at the slice's edges
+                    assert(s.next > 0);
+                    const auto i = s.next - 1, j = s.next;
+                    const auto t = (double)(stop.time - b.time[i]) / (double)(b.time[j] - b.time[i]);
+                    const auto price = mid(i) * (1 - t) + t * mid(j);
+
+                    stop.points.insert(std::pair(s.company, Timepoint {
+                        .time   = static_cast<time_t>(stop.time),
+                        .price  = price,
+                        .open   = price,
+                        .high   = price,
+                        .low    = price,
+                        .close  = price,
+                        .volume = 0.0,
+                        .interpolated = true
+                    }));
+                }
+            }
+
+            {
+                SFL_TRACE_SCOPE("driver.panel");
+                panel.build(companies, stops);
+            }
+            strategy->panel = &panel;
+            panel_bytes = std::max(panel_bytes, panel.footprint());
+
+            if (ticks && !replay)
+                replay.emplace(*ticks, static_cast<int64_t>(stops.front().time) * nanoseconds_per_second);
+
+            for (std::size_t i = carried; i < stops.size(); i++)
+                play(stops, i, replay);
+        }
+
+        sink.flush();
+        measure(bars_bytes, panel_bytes);
+    }
+
+    // Fills in the footprint at the end of a run, `file` and `panel` are the largest held during it
+    void measure(std::size_t file_bytes, std::size_t panel_bytes)
+    {
+        auto& tracked = util::memory::registry().total;
+
+        usage.stops    = static_cast<std::size_t>(StopMemory::account().bytes.load());
+        usage.universe = static_cast<std::size_t>(tracked.bytes.load()) - usage.stops 
+                       - static_cast<std::size_t>(AlignmentMemory::account().bytes.load());
+        usage.file     = file_bytes;
+        usage.panel    = panel_bytes;
+        usage.equity   = equity.footprint();
+        usage.strategy = sizeof(S) + strategy->portfolio.positions.bucket_count() * sizeof(void*)
+                       + strategy->portfolio.positions.size() * (sizeof(void*) + sizeof(std::pair<util::id_t, Portfolio::Position>));
+        usage.peak     = static_cast<std::size_t>(tracked.peak.load()) 
+                       + usage.file + usage.panel + usage.equity + usage.strategy;
+    }
+
+    EquityCurve equity;
+    BasicPanel<typename S::price_type> panel;
+    Footprint usage;
 
     File file;
     std::unique_ptr<S> strategy;
+
+    // the file streamed by an out-of-core run
+    std::string source;
+    Slices slices;
 };
 
 }
@@ -0,0 +1,336 @@
+#pragma once
+
+#include <queue>
+
+#include <sfl/def.hpp>
+
+#include "Stop.hpp"
+#include "Portfolio.hpp"
+
+namespace sfl
+{
+
+struct Order
+{
+    using id_type = uint64_t;
+
+    enum Side
+    {
+        Buy, Sell
+    };
+
+    enum class Type
+    {
+        Market,    // fills at the next bar's open
+        Limit,     // fills once the bar trades through the limit price
+        Stop,      // becomes a market order once the bar trades through the stop price
+        StopLimit  // becomes a limit order once the bar trades through the stop price. On that bar it
+                   // fills where it triggered (the stop, or the open past it) if that's within the limit,
+                   // otherwise it rests as a limit order from the next bar on
+    };
+
+    enum class Status
+    {
+        Open, Filled, Cancelled, Rejected
+    };
+
+    id_type     id;
+    util::id_t  company;
+    Side        side;
+    Type        type;
+    int64_t     quantity;
+    double      limit, stop;
+    std::size_t placed;
+    Status      status    = Status::Open;
+    bool        triggered = false;
+};
+
+struct Fill
+{
+    Order::id_type order;
+    util::id_t     company;
+    std::size_t    time;
+    int64_t        quantity; // signed, negative for sells
+    double         price;
+    double         commission;
+};
+
+// Returns the commission charged for a fill
+using CommissionModel = std::function<double(const Fill&)>;
+
+// Returns the price actually obtained given the price the bar offered
+using SlippageModel = std::function<double(const Order&, const Timepoint&, double)>;
+
+namespace commission
+{
+    inline CommissionModel none()
+    {
+        return [](const Fill&) { return 0.0; };
+    }
+
+    inline CommissionModel perShare(double rate, double minimum = 0.0)
+    {
+        return [=](const Fill& f) { return std::max(minimum, rate * static_cast<double>(std::abs(f.quantity))); };
+    }
+
+    inline CommissionModel percent(double rate, double minimum = 0.0)
+    {
+        return [=](const Fill& f) { return std::max(minimum, rate * f.price * static_cast<double>(std::abs(f.quantity))); };
+    }
+}
+
+namespace slippage
+{
+    inline SlippageModel none()
+    {
+        return [](const Order&, const Timepoint&, double price) { return price; };
+    }
+
+    // moves the price against the order by a fixed amount of basis points
+    inline SlippageModel basisPoints(double bps)
+    {
+        return [=](const Order& o, const Timepoint&, double price)
+        {
+            return price * (1.0 + (o.side == Order::Buy ? 1.0 : -1.0) * bps / 10000.0);
+        };
+    }
+
+    // moves the price against the order by a fraction of the bar's range
+    inline SlippageModel range(double fraction)
+    {
+        return [=](const Order& o, const Timepoint& bar, double price)
+        {
+            const auto moved = price + (o.side == Order::Buy ? 1.0 : -1.0) * fraction * (bar.high - bar.low);
+            return std::clamp(moved, bar.low, bar.high);
+        };
+    }
+}
+
+/*
+
+Bar level execution simulator. Resting orders are kept per company in four
+heaps keyed on their trigger price (buy limits highest first, sell limits
+lowest first, buy stops lowest first, sell stops highest first), so a bar only
+pops the orders its high/low actually reaches. Ties keep submission order.
+Cancelled orders are dropped lazily when they reach the top of their heap.
+
+Orders submitted during a stop are matched against the following stop, and
+slippage only applies to orders that execute at market (market and triggered
+stop orders); limit orders fill at their limit or better.
+
+*/
+struct Execution
+{
+    CommissionModel commission = commission::none();
+    SlippageModel   slippage   = slippage::none();
+    bool            allow_short = false;
+
+    Order::id_type submit(Order order)
+    {
+        order.id = orders.size() + 1;
+        order.status = Order::Status::Open;
+        order.triggered = false;
+        orders.push_back(order);
+
+        auto& book = books[order.company];
+        switch (order.type)
+        {
+        case Order::Type::Market:    book.market.push_back(order.id); break;
+        case Order::Type::Limit:     book.pushLimit(order); break;
+        case Order::Type::Stop:
+        case Order::Type::StopLimit: book.pushStop(order); break;
+        }
+
+        resting++;
+        return order.id;
+    }
+
+    bool cancel(Order::id_type id)
+    {
+        if (!id || id > orders.size()) return false;
+        auto& o = orders[id - 1];
+        if (o.status != Order::Status::Open) return false;
+        o.status = Order::Status::Cancelled;
+        resting--;
+        return true;
+    }
+
+    const Order& order(Order::id_type id) const
+    {
+        assert(id && id <= orders.size());
+        return orders[id - 1];
+    }
+
+    std::size_t open() const { return resting; }
+
+    // Matches the resting orders against the bars of the given stop and applies the fills
+    // to the portfolio. The returned span is valid until the next call.
+    std::span<const Fill> match(const Stop& stop, Portfolio& portfolio)
+    {
+        fills.clear();
+        if (!resting) return fills;
+
+        for (auto& b : books)
+        {
+            auto& book = b.second;
+            if (book.empty()) continue;
+
+            const auto it = stop.points.find(b.first);
+            if (it == stop.points.end() || it->second.interpolated) continue;
+
+            const auto& bar = it->second;
+
+            for (const auto id : book.market)
+                execute(orders[id - 1], bar, bar.open, true, stop.time, portfolio);
+            book.market.clear();
+
+            // stops first, a triggered stop limit may still fill on the same bar
+            armed.clear();
+            while (!book.buy_stops.empty() && book.buy_stops.top().price <= bar.high)
+            {
+                auto& o = orders[book.buy_stops.top().order - 1];
+                book.buy_stops.pop();
+                trigger(o, bar, stop.time, portfolio);
+            }
+
+            while (!book.sell_stops.empty() && book.sell_stops.top().price >= bar.low)
+            {
+                auto& o = orders[book.sell_stops.top().order - 1];
+                book.sell_stops.pop();
+                trigger(o, bar, stop.time, portfolio);
+            }
+
+            while (!book.buy_limits.empty() && book.buy_limits.top().price >= bar.low)
+            {
+                auto& o = orders[book.buy_limits.top().order - 1];
+                book.buy_limits.pop();
+                execute(o, bar, std::min(bar.open, o.limit), false, stop.time, portfolio);
+            }
+
+            while (!book.sell_limits.empty() && book.sell_limits.top().price <= bar.high)
+            {
+                auto& o = orders[book.sell_limits.top().order - 1];
+                book.sell_limits.pop();
+                execute(o, bar, std::max(bar.open, o.limit), false, stop.time, portfolio);
+            }
+
+            // stop limits that couldn't fill where they triggered rest from the next bar on
+            for (const auto id : armed)
+                book.pushLimit(orders[id - 1]);
+        }
+
+        return fills;
+    }
+
+private:
+    struct Entry
+    {
+        double price;
+        Order::id_type order;
+    };
+
+    // top() is the entry with the highest price, earliest order first
+    struct Highest
+    {
+        bool operator()(const Entry& a, const Entry& b) const
+        { return (a.price != b.price ? a.price < b.price : a.order > b.order); }
+    };
+
+    // top() is the entry with the lowest price, earliest order first
+    struct Lowest
+    {
+        bool operator()(const Entry& a, const Entry& b) const
+        { return (a.price != b.price ? a.price > b.price : a.order > b.order); }
+    };
+
+    template<typename Compare>
+    using Heap = std::priority_queue<Entry, std::vector<Entry>, Compare>;
+
+    struct Book
+    {
+        std::vector<Order::id_type> market;
+        Heap<Highest> buy_limits;
+        Heap<Lowest>  sell_limits;
+        Heap<Lowest>  buy_stops;
+        Heap<Highest> sell_stops;
+
+        void pushLimit(const Order& o)
+        {
+            if (o.side == Order::Buy) buy_limits.push(Entry{ o.limit, o.id });
+            else                      sell_limits.push(Entry{ o.limit, o.id });
+        }
+
+        void pushStop(const Order& o)
+        {
+            if (o.side == Order::Buy) buy_stops.push(Entry{ o.stop, o.id });
+            else                      sell_stops.push(Entry{ o.stop, o.id });
+        }
+
+        bool empty() const
+        {
+            return market.empty() && buy_limits.empty() && sell_limits.empty() && buy_stops.empty() && sell_stops.empty();
+        }
+    };
+
+    void trigger(Order& o, const Timepoint& bar, std::size_t time, Portfolio& portfolio)
+    {
+        if (o.status != Order::Status::Open) return;
+        o.triggered = true;
+
+        // a bar that gaps through the stop fills at the open
+        const auto price = (o.side == Order::Buy ? std::max(bar.open, o.stop) : std::min(bar.open, o.stop));
+
+        if (o.type == Order::Type::StopLimit)
+        {
+            // the order only exists from the trigger on, so it can't fill below (above) it on this bar
+            if (o.side == Order::Buy ? price <= o.limit : price >= o.limit)
+                execute(o, bar, price, false, time, portfolio);
+            else
+                armed.push_back(o.id);
+            return;
+        }
+
+        execute(o, bar, price, true, time, portfolio);
+    }
+
+    void execute(Order& o, const Timepoint& bar, double price, bool at_market, std::size_t time, Portfolio& portfolio)
+    {
+        if (o.status != Order::Status::Open) return;
+        resting--;
+
+        if (at_market) price = slippage(o, bar, price);
+
+        const int64_t quantity = (o.side == Order::Buy ? o.quantity : -o.quantity);
+        Fill fill {
+            .order      = o.id,
+            .company    = o.company,
+            .time       = time,
+            .quantity   = quantity,
+            .price      = price,
+            .commission = 0.0
+        };
+        fill.commission = commission(fill);
+
+        const bool refused = (o.side == Order::Buy
+            ? portfolio.cash < price * static_cast<double>(o.quantity) + fill.commission
+            : !allow_short && portfolio.quantity(o.company) < o.quantity);
+
+        if (refused)
+        {
+            o.status = Order::Status::Rejected;
+            return;
+        }
+
+        o.status = Order::Status::Filled;
+        portfolio.fill(o.company, quantity, price, fill.commission);
+        fills.push_back(fill);
+    }
+
+    std::vector<Order> orders; // indexed by id - 1
+    std::unordered_map<util::id_t, Book> books;
+    std::vector<Fill> fills;
+    std::vector<Order::id_type> armed; // stop limits triggered on the bar being matched
+    std::size_t resting = 0;
+};
+
+}
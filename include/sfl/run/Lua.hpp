@@ -0,0 +1,323 @@
+#pragma once
+
+#include <lua.hpp>
+
+#include "Driver.hpp"
+
+namespace sfl
+{
+
+namespace detail
+{
+
+// Order helpers append to one flat array inside Lua, the driver reads the whole batch after each step
+inline constexpr const char* lua_prelude = R"(
+orders = { n = 0 }
+
+function buy(column, quantity, limit)
+    local o, n = orders, orders.n
+    o[n + 1], o[n + 2], o[n + 3] = column, quantity or 1, limit or 0
+    o.n = n + 3
+end
+
+function sell(column, quantity, limit)
+    local o, n = orders, orders.n
+    o[n + 1], o[n + 2], o[n + 3] = column, -(quantity or 1), limit or 0
+    o.n = n + 3
+end
+)";
+
+/*
+
+Lua states of the calling thread, by script. A state runs the prelude and
+the script once, when it's first created; after that strategies borrow and
+return it, so a sweep running many backtests on a worker thread loads each
+script once per thread. States are closed when the thread exits.
+
+*/
+struct LuaPool
+{
+    ~LuaPool()
+    {
+        for (auto& p : idle)
+            for (auto* L : p.second)
+                lua_close(L);
+    }
+
+    // nullptr if the script fails to load
+    lua_State* acquire(const std::string& script)
+    {
+        auto& states = idle[script];
+        if (states.empty()) return load(script);
+
+        auto* L = states.back();
+        states.pop_back();
+        return L;
+    }
+
+    void release(const std::string& script, lua_State* L)
+    {
+        lua_settop(L, 0);
+        idle[script].push_back(L);
+    }
+
+    static LuaPool& local()
+    {
+        thread_local LuaPool pool;
+        return pool;
+    }
+
+private:
+    static lua_State* load(const std::string& script)
+    {
+        lua_State* L = luaL_newstate();
+        assert(L);
+        luaL_openlibs(L);
+
+        if (luaL_loadstring(L, lua_prelude) != LUA_OK || lua_pcall(L, 0, 0, 0) != LUA_OK ||
+            luaL_loadfilex(L, script.c_str(), nullptr) != LUA_OK || lua_pcall(L, 0, 0, 0) != LUA_OK)
+        {
+            std::cerr << script << ": " << lua_tostring(L, -1) << '\n';
+            lua_close(L);
+            return nullptr;
+        }
+
+        return L;
+    }
+
+    std::unordered_map<std::string, std::vector<lua_State*>> idle;
+};
+
+} // namespace detail
+
+/*
+
+A strategy written in Lua, driven like any other by Driver<LuaStrategy>(file, script).
+
+The script sees these globals, all indexed by panel column starting at 1:
+    prices     the current stop's prices
+    companies  the tickers
+    positions  the quantity held
+    ctx        time, row, cash and equity of the current stop
+and defines
+    step()                            called every stop, required
+    start(width)                      called on the first stop of every run
+    filled(column, quantity, price)   called for every fill, quantity is signed
+It trades with buy(column, quantity, limit) and sell(column, quantity, limit),
+market orders when the limit is left out. Columns and quantities that aren't
+whole numbers are truncated towards zero.
+
+Nothing is built per stop: the tables are allocated once per run and
+overwritten in place, and the orders of a step come back as one flat array.
+Since states are reused, scripts should set up their own state in start().
+
+*/
+struct LuaStrategy : BaseStrategy
+{
+    LuaStrategy(std::string _script) :
+        script(std::move(_script)),
+        L(detail::LuaPool::local().acquire(script))
+    {   }
+
+    LuaStrategy(LuaStrategy&&) = delete;
+    LuaStrategy(const LuaStrategy&) = delete;
+
+    ~LuaStrategy()
+    {
+        if (!L) return;
+
+        for (auto* ref : { &prices_ref, &companies_ref, &positions_ref, &context_ref, &orders_ref, &step_ref, &filled_ref })
+            unref(*ref);
+
+        detail::LuaPool::local().release(script, L);
+    }
+
+    void step() override
+    {
+        if (!L || failed) return;
+        if (row == 0 && !prepare()) return;
+
+        const auto p = prices();
+        lua_rawgeti(L, LUA_REGISTRYINDEX, prices_ref);
+        for (std::size_t c = 0; c < p.size(); c++)
+        {
+            lua_pushnumber(L, p[c]);
+            lua_rawseti(L, -2, static_cast<lua_Integer>(c + 1));
+        }
+        lua_pop(L, 1);
+
+        lua_rawgeti(L, LUA_REGISTRYINDEX, context_ref);
+        lua_pushinteger(L, static_cast<lua_Integer>(current_stop.time));
+        lua_setfield(L, -2, "time");
+        lua_pushinteger(L, static_cast<lua_Integer>(row + 1));
+        lua_setfield(L, -2, "row");
+        lua_pushnumber(L, portfolio.cash);
+        lua_setfield(L, -2, "cash");
+        lua_pushnumber(L, portfolio.value());
+        lua_setfield(L, -2, "equity");
+        lua_pop(L, 1);
+
+        lua_rawgeti(L, LUA_REGISTRYINDEX, step_ref);
+        if (!call(0)) return;
+
+        submitOrders();
+    }
+
+    void filled(const Fill& fill) override
+    {
+        if (!L || failed) return;
+
+        const auto column = panel->column(fill.company);
+        if (!column) return;
+
+        lua_rawgeti(L, LUA_REGISTRYINDEX, positions_ref);
+        lua_pushinteger(L, static_cast<lua_Integer>(portfolio.quantity(fill.company)));
+        lua_rawseti(L, -2, static_cast<lua_Integer>(*column + 1));
+        lua_pop(L, 1);
+
+        if (filled_ref == LUA_NOREF) return;
+
+        lua_rawgeti(L, LUA_REGISTRYINDEX, filled_ref);
+        lua_pushinteger(L, static_cast<lua_Integer>(*column + 1));
+        lua_pushinteger(L, static_cast<lua_Integer>(fill.quantity));
+        lua_pushnumber(L, fill.price);
+        call(3);
+    }
+
+private:
+    // Allocates this run's tables and looks up the script's functions
+    bool prepare()
+    {
+        const auto width = panel->width();
+
+        const auto table = [&](int& ref, const char* global, int size)
+        {
+            unref(ref);
+            lua_createtable(L, size, 0);
+            lua_pushvalue(L, -1);
+            lua_setglobal(L, global);
+            ref = luaL_ref(L, LUA_REGISTRYINDEX);
+        };
+
+        table(prices_ref,    "prices",    static_cast<int>(width));
+        table(companies_ref, "companies", static_cast<int>(width));
+        table(positions_ref, "positions", static_cast<int>(width));
+        table(context_ref,   "ctx",       0);
+
+        lua_rawgeti(L, LUA_REGISTRYINDEX, companies_ref);
+        for (std::size_t c = 0; c < width; c++)
+        {
+            const auto company = Company::get(panel->companies[c]);
+            lua_pushstring(L, (company->ticker.empty() ? company->name : company->ticker).c_str());
+            lua_rawseti(L, -2, static_cast<lua_Integer>(c + 1));
+        }
+        lua_pop(L, 1);
+
+        lua_rawgeti(L, LUA_REGISTRYINDEX, positions_ref);
+        for (std::size_t c = 0; c < width; c++)
+        {
+            lua_pushinteger(L, static_cast<lua_Integer>(portfolio.quantity(panel->companies[c])));
+            lua_rawseti(L, -2, static_cast<lua_Integer>(c + 1));
+        }
+        lua_pop(L, 1);
+
+        unref(orders_ref);
+        lua_getglobal(L, "orders");
+        lua_pushinteger(L, 0);
+        lua_setfield(L, -2, "n");
+        orders_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+        const auto function = [&](int& ref, const char* name)
+        {
+            unref(ref);
+            lua_getglobal(L, name);
+            if (lua_isfunction(L, -1)) ref = luaL_ref(L, LUA_REGISTRYINDEX);
+            else lua_pop(L, 1);
+        };
+
+        function(step_ref,   "step");
+        function(filled_ref, "filled");
+
+        if (step_ref == LUA_NOREF)
+        {
+            std::cerr << script << ": no step() function\n";
+            failed = true;
+            return false;
+        }
+
+        lua_getglobal(L, "start");
+        if (!lua_isfunction(L, -1))
+        {
+            lua_pop(L, 1);
+            return true;
+        }
+
+        lua_pushinteger(L, static_cast<lua_Integer>(width));
+        return call(1);
+    }
+
+    // Reads the step's order batch, then empties it in place
+    void submitOrders()
+    {
+        lua_rawgeti(L, LUA_REGISTRYINDEX, orders_ref);
+        lua_getfield(L, -1, "n");
+        const auto n = lua_tointeger(L, -1);
+        lua_pop(L, 1);
+
+        for (lua_Integer i = 1; i + 2 <= n; i += 3)
+        {
+            lua_rawgeti(L, -1, i);
+            lua_rawgeti(L, -2, i + 1);
+            lua_rawgeti(L, -3, i + 2);
+            // lua_tointeger gives 0 for 2.5 or 10 / 4, fractional columns and quantities are truncated instead
+            const auto column   = std::trunc(lua_tonumber(L, -3));
+            const auto quantity = std::trunc(lua_tonumber(L, -2));
+            const auto limit    = lua_tonumber(L, -1);
+            lua_pop(L, 3);
+
+            // the comparisons also drop NaN, and infinities fail the bound on the quantity
+            if (!(column >= 1.0 && column <= static_cast<double>(panel->width()))) continue;
+            if (!(quantity != 0.0 && std::abs(quantity) <= 9007199254740992.0)) continue; // 2^53
+
+            const auto company = panel->companies[static_cast<std::size_t>(column) - 1];
+            const auto side    = (quantity > 0 ? Order::Buy : Order::Sell);
+            const auto type    = (limit > 0.0 ? Order::Type::Limit : Order::Type::Market);
+            submit(company, side, type, static_cast<int64_t>(std::abs(quantity)), limit);
+        }
+
+        lua_pushinteger(L, 0);
+        lua_setfield(L, -2, "n");
+        lua_pop(L, 1);
+    }
+
+    // Calls the function below `arguments` on the stack, a script error stops the strategy
+    bool call(int arguments)
+    {
+        if (lua_pcall(L, arguments, 0, 0) == LUA_OK) return true;
+
+        std::cerr << script << ": " << lua_tostring(L, -1) << '\n';
+        lua_pop(L, 1);
+        failed = true;
+        return false;
+    }
+
+    void unref(int& ref)
+    {
+        if (ref != LUA_NOREF) luaL_unref(L, LUA_REGISTRYINDEX, ref);
+        ref = LUA_NOREF;
+    }
+
+    std::string script;
+    lua_State* L;
+    bool failed = false;
+
+    int prices_ref    = LUA_NOREF;
+    int companies_ref = LUA_NOREF;
+    int positions_ref = LUA_NOREF;
+    int context_ref   = LUA_NOREF;
+    int orders_ref    = LUA_NOREF;
+    int step_ref      = LUA_NOREF;
+    int filled_ref    = LUA_NOREF;
+};
+
+}
@@ -0,0 +1,309 @@
+#pragma once
+
+#include <cmath>
+
+#include <sfl/def.hpp>
+#include <sfl/util/Simd.hpp>
+
+#include "Portfolio.hpp"
+#include "Execution.hpp"
+
+namespace sfl
+{
+
+// Welford's online mean/variance
+struct RunningStats
+{
+    std::size_t count = 0;
+    double mean = 0.0, m2 = 0.0;
+
+    void push(double x)
+    {
+        count++;
+        const double delta = x - mean;
+        mean += delta / static_cast<double>(count);
+        m2   += delta * (x - mean);
+    }
+
+    double variance() const { return (count > 1 ? m2 / static_cast<double>(count - 1) : 0.0); }
+    double stddev()   const { return std::sqrt(variance()); }
+};
+
+struct Summary
+{
+    std::size_t periods = 0, trades = 0;
+    double total_return = 0.0;
+    double mean_return  = 0.0; // per period
+    double volatility   = 0.0; // annualized
+    double sharpe       = 0.0; // annualized, zero risk free rate
+    double sortino      = 0.0; // annualized
+    double max_drawdown = 0.0; // fraction of the running peak
+    double exposure     = 0.0; // average |market value| / equity
+    double turnover     = 0.0; // traded notional / average equity
+};
+
+inline std::ostream& operator<<(std::ostream& os, const Summary& s)
+{
+    os << "return "    << s.total_return * 100.0 << "%"
+       << ", sharpe "  << s.sharpe
+       << ", sortino " << s.sortino
+       << ", max dd "  << s.max_drawdown * 100.0 << "%"
+       << ", exposure " << s.exposure * 100.0 << "%"
+       << ", turnover " << s.turnover
+       << ", trades "  << s.trades;
+    return os;
+}
+
+// 30 minute bars, 13 per trading session
+constexpr double default_periods_per_year = 252.0 * 13.0;
+
+namespace detail
+{
+    inline Summary finish(
+        std::size_t periods, double first, double last,
+        double mean, double variance, double downside, // downside is the mean squared negative return
+        double max_drawdown, double exposure_sum, double equity_sum,
+        double traded, std::size_t trades, double periods_per_year)
+    {
+        Summary s;
+        s.periods      = periods;
+        s.trades       = trades;
+        s.total_return = (first != 0.0 ? last / first - 1.0 : 0.0);
+        s.mean_return  = mean;
+        s.volatility   = std::sqrt(variance * periods_per_year);
+        s.sharpe       = (variance > 0.0 ? mean / std::sqrt(variance) * std::sqrt(periods_per_year) : 0.0);
+        s.sortino      = (downside > 0.0 ? mean / std::sqrt(downside) * std::sqrt(periods_per_year) : 0.0);
+        s.max_drawdown = max_drawdown;
+        s.exposure     = (periods ? exposure_sum / static_cast<double>(periods) : 0.0);
+        s.turnover     = (equity_sum > 0.0 ? traded / (equity_sum / static_cast<double>(periods)) : 0.0);
+        return s;
+    }
+}
+
+/*
+
+Streaming metrics, fed one equity point per stop and every fill as it happens.
+Everything is O(1) per update so it can run inside the driver loop for every
+run of a sweep.
+
+*/
+struct Metrics
+{
+    double periods_per_year = default_periods_per_year;
+
+    void record(double equity, double market)
+    {
+        if (!periods) first = equity;
+        else if (last != 0.0)
+        {
+            const double r = equity / last - 1.0;
+            returns.push(r);
+            if (r < 0.0) downside += r * r;
+        }
+
+        peak = std::max(peak, equity);
+        if (peak > 0.0) max_drawdown = std::max(max_drawdown, 1.0 - equity / peak);
+
+        if (equity != 0.0) exposure_sum += std::abs(market) / equity;
+        equity_sum += equity;
+        last = equity;
+        periods++;
+    }
+
+    void trade(const Fill& fill)
+    {
+        traded += std::abs(static_cast<double>(fill.quantity) * fill.price);
+        trades++;
+    }
+
+    Summary summary() const
+    {
+        return detail::finish(
+            periods, first, last,
+            returns.mean, returns.variance(),
+            (returns.count ? downside / static_cast<double>(returns.count) : 0.0),
+            max_drawdown, exposure_sum, equity_sum,
+            traded, trades, periods_per_year);
+    }
+
+    void clear()
+    {
+        const auto ppy = periods_per_year;
+        *this = Metrics{};
+        periods_per_year = ppy;
+    }
+
+private:
+    RunningStats returns;
+    std::size_t periods = 0, trades = 0;
+    double first = 0.0, last = 0.0, peak = 0.0;
+    double downside = 0.0, max_drawdown = 0.0;
+    double exposure_sum = 0.0, equity_sum = 0.0, traded = 0.0;
+};
+
+/*
+
+Batch versions of the same metrics over stored equity curves, used to score
+sweep results after the fact. The reductions are written with
+std::experimental::simd when the standard library provides it and fall back
+to plain loops otherwise.
+
+*/
+namespace batch
+{
+
+namespace detail
+{
+#ifdef SFL_HAS_SIMD
+    namespace stdx = util::stdx;
+    using util::vdouble;
+#endif
+
+    struct Sums
+    {
+        double returns = 0.0, downside = 0.0, exposure = 0.0, equity = 0.0;
+    };
+
+    // first pass: sum of returns, squared negative returns, exposure and equity
+    inline Sums sums(const double* equity, const double* market, std::size_t n)
+    {
+        Sums s;
+        std::size_t i = 0;
+
+#ifdef SFL_HAS_SIMD
+        vdouble r_sum = 0.0, d_sum = 0.0, x_sum = 0.0, e_sum = 0.0;
+        for (; i + vdouble::size() < n; i += vdouble::size())
+        {
+            const vdouble prev(equity + i,     stdx::element_aligned);
+            const vdouble next(equity + i + 1, stdx::element_aligned);
+            const vdouble mkt (market + i,     stdx::element_aligned);
+
+            const vdouble r = next / prev - 1.0;
+            r_sum += r;
+
+            vdouble neg = r;
+            stdx::where(neg > 0.0, neg) = 0.0;
+            d_sum += neg * neg;
+
+            x_sum += stdx::abs(mkt) / prev;
+            e_sum += prev;
+        }
+
+        s.returns  = stdx::reduce(r_sum);
+        s.downside = stdx::reduce(d_sum);
+        s.exposure = stdx::reduce(x_sum);
+        s.equity   = stdx::reduce(e_sum);
+#endif
+
+        for (; i + 1 < n; i++)
+        {
+            const double r = equity[i + 1] / equity[i] - 1.0;
+            s.returns  += r;
+            s.downside += (r < 0.0 ? r * r : 0.0);
+            s.exposure += std::abs(market[i]) / equity[i];
+            s.equity   += equity[i];
+        }
+
+        if (n)
+        {
+            s.exposure += std::abs(market[n - 1]) / equity[n - 1];
+            s.equity   += equity[n - 1];
+        }
+
+        return s;
+    }
+
+    // second pass: sum of squared deviations from the mean return
+    inline double deviations(const double* equity, std::size_t n, double mean)
+    {
+        double total = 0.0;
+        std::size_t i = 0;
+
+#ifdef SFL_HAS_SIMD
+        vdouble sum = 0.0;
+        for (; i + vdouble::size() < n; i += vdouble::size())
+        {
+            const vdouble prev(equity + i,     stdx::element_aligned);
+            const vdouble next(equity + i + 1, stdx::element_aligned);
+            const vdouble d = next / prev - 1.0 - mean;
+            sum += d * d;
+        }
+        total = stdx::reduce(sum);
+#endif
+
+        for (; i + 1 < n; i++)
+        {
+            const double d = equity[i + 1] / equity[i] - 1.0 - mean;
+            total += d * d;
+        }
+
+        return total;
+    }
+
+    inline double drawdown(const double* equity, std::size_t n)
+    {
+        double peak = 0.0, worst = 0.0;
+        for (std::size_t i = 0; i < n; i++)
+        {
+            peak  = std::max(peak, equity[i]);
+            worst = std::max(worst, (peak > 0.0 ? 1.0 - equity[i] / peak : 0.0));
+        }
+        return worst;
+    }
+}
+
+inline Summary compute(
+    const EquityCurve& curve,
+    std::span<const Fill> fills = {},
+    double periods_per_year = default_periods_per_year)
+{
+    const auto n = curve.size();
+    if (!n) return Summary{};
+
+    const auto* equity = curve.equity.data();
+    const auto s = detail::sums(equity, curve.market.data(), n);
+
+    const auto count = n - 1;
+    const double mean = (count ? s.returns / static_cast<double>(count) : 0.0);
+    const double variance = (count > 1 ? detail::deviations(equity, n, mean) / static_cast<double>(count - 1) : 0.0);
+
+    double traded = 0.0;
+    for (const auto& f : fills)
+        traded += std::abs(static_cast<double>(f.quantity) * f.price);
+
+    return sfl::detail::finish(
+        n, equity[0], equity[n - 1],
+        mean, variance, (count ? s.downside / static_cast<double>(count) : 0.0),
+        detail::drawdown(equity, n), s.exposure, s.equity,
+        traded, fills.size(), periods_per_year);
+}
+
+}
+
+// Returns the indices of the given summaries ordered by a field, best first.
+// Pass a k to only order the top k entries.
+inline std::vector<std::size_t>
+rank(
+    std::span<const Summary> summaries, 
+    double Summary::* key = &Summary::sharpe,
+    std::optional<std::size_t> k = std::nullopt,
+    bool descending = true)
+{
+    std::vector<std::size_t> order(summaries.size());
+    for (std::size_t i = 0; i < order.size(); i++) order[i] = i;
+
+    // max drawdown is the only field where smaller is better
+    if (key == &Summary::max_drawdown) descending = !descending;
+
+    const auto pred = [&](std::size_t a, std::size_t b)
+    {
+        return (descending ? summaries[a].*key > summaries[b].*key : summaries[a].*key < summaries[b].*key);
+    };
+
+    const auto top = std::min(k.value_or(order.size()), order.size());
+    std::partial_sort(order.begin(), order.begin() + top, order.end(), pred);
+    order.resize(top);
+    return order;
+}
+
+}
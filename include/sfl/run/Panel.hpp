@@ -0,0 +1,95 @@
+#pragma once
+
+#include <sfl/def.hpp>
+#include <sfl/data/Objects.hpp>
+#include <sfl/data/Price.hpp>
+
+#include "Stop.hpp"
+
+namespace sfl
+{
+
+/*
+
+Dense stops x companies price matrix built by the driver next to the stops.
+Each company gets a fixed column, so a stop is a contiguous row of prices
+that cross-sectional kernels can run over without hashing.
+
+Prices are held in the representation of the price policy P, a missing
+price is P::encode(NaN). A float panel is half the size of a double one and
+its rows fill twice the SIMD lanes.
+
+*/
+template<typename P = DoublePrice>
+struct BasicPanel
+{
+    using price_type = P;
+    using value_type = typename P::value_type;
+
+    std::vector<util::id_t> companies;     // column -> company
+    std::vector<uint32_t>   groups;        // column -> exchange group
+    std::vector<util::id_t> exchanges;     // group -> exchange
+    std::vector<std::size_t> times;        // row -> stop time
+    std::vector<value_type> prices;        // row major
+
+    void build(std::span<const util::id_t> _companies, std::span<const Stop> stops)
+    {
+        companies.assign(_companies.begin(), _companies.end());
+        columns.clear();
+        groups.clear();
+        exchanges.clear();
+
+        for (uint32_t c = 0; c < companies.size(); c++)
+        {
+            columns[companies[c]] = c;
+
+            const auto exchange = Company::get(companies[c])->exchangeID();
+            const auto it = std::find(exchanges.begin(), exchanges.end(), exchange);
+            groups.push_back(static_cast<uint32_t>(std::distance(exchanges.begin(), it)));
+            if (it == exchanges.end()) exchanges.push_back(exchange);
+        }
+
+        times.resize(stops.size());
+        prices.assign(stops.size() * width(), P::encode(std::numeric_limits<double>::quiet_NaN()));
+        for (std::size_t r = 0; r < stops.size(); r++)
+        {
+            times[r] = stops[r].time;
+            for (const auto& p : stops[r].points)
+                prices[r * width() + columns.at(p.first)] = P::encode(p.second.price);
+        }
+    }
+
+    std::size_t width() const { return companies.size(); }
+    std::size_t rows()  const { return times.size(); }
+
+    std::span<const value_type> row(std::size_t r) const
+    {
+        assert(r < rows());
+        return std::span<const value_type>(prices.data() + r * width(), width());
+    }
+
+    double price(std::size_t r, std::size_t column) const { return P::decode(row(r)[column]); }
+
+    // Bytes held by the matrix and the column tables
+    std::size_t footprint() const
+    {
+        return companies.capacity() * sizeof(util::id_t) + groups.capacity() * sizeof(uint32_t)
+             + exchanges.capacity() * sizeof(util::id_t) + times.capacity() * sizeof(std::size_t)
+             + prices.capacity() * sizeof(value_type)
+             + columns.bucket_count() * sizeof(void*) + columns.size() * (sizeof(void*) + sizeof(std::pair<util::id_t, uint32_t>));
+    }
+
+    std::optional<uint32_t> column(const util::id_t& company) const
+    {
+        const auto it = columns.find(company);
+        if (it == columns.end()) return std::nullopt;
+        return it->second;
+    }
+
+private:
+    std::unordered_map<util::id_t, uint32_t> columns;
+};
+
+using Panel = BasicPanel<DoublePrice>;
+
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <sfl/def.hpp>
+
+namespace sfl
+{
+
+/*
+
+Equity curve recorded by the driver, one entry per stop. Stored column-wise
+so that the buffers can be reserved once for the whole run and handed to
+metrics/exporters without any transposition.
+
+*/
+struct EquityCurve
+{
+    std::vector<std::size_t> time;
+    std::vector<double> cash, market, equity;
+
+    void reserve(std::size_t count)
+    {
+        time.reserve(count);
+        cash.reserve(count);
+        market.reserve(count);
+        equity.reserve(count);
+    }
+
+    void record(std::size_t t, double c, double m)
+    {
+        time.push_back(t);
+        cash.push_back(c);
+        market.push_back(m);
+        equity.push_back(c + m);
+    }
+
+    void clear()
+    {
+        time.clear();
+        cash.clear();
+        market.clear();
+        equity.clear();
+    }
+
+    std::size_t size() const { return time.size(); }
+
+    std::size_t footprint() const
+    {
+        return time.capacity() * sizeof(std::size_t)
+             + (cash.capacity() + market.capacity() + equity.capacity()) * sizeof(double);
+    }
+};
+
+/*
+
+Positions are kept at average cost. Every aggregate (cash, market value, cost
+basis, realized profit) is updated as fills and prices come in, so querying
+the value or the profit of the portfolio never walks the trade history.
+
+*/
+struct Portfolio
+{
+    struct Position
+    {
+        int64_t quantity = 0;
+        double  cost     = 0.0; // cost basis of the open quantity
+        double  price    = 0.0; // last marked price
+    };
+
+    double cash       = 0.0;
+    double realized   = 0.0;
+    double fees       = 0.0;
+    double market     = 0.0; // sum of quantity * price over every position
+    double cost_basis = 0.0; // sum of cost over every position
+
+    std::unordered_map<util::id_t, Position> positions;
+
+    const Position* position(const util::id_t& company) const
+    {
+        const auto it = positions.find(company);
+        return (it == positions.end() ? nullptr : &it->second);
+    }
+
+    int64_t quantity(const util::id_t& company) const
+    {
+        const auto* p = position(company);
+        return (p ? p->quantity : 0);
+    }
+
+    // quantity is signed: positive buys, negative sells
+    void fill(const util::id_t& company, int64_t quantity, double price, double fee = 0.0)
+    {
+        if (!quantity) return;
+
+        auto& p = positions[company];
+
+        market += static_cast<double>(p.quantity) * (price - p.price);
+        p.price = price;
+
+        const double old_cost = p.cost;
+
+        // the part of the fill that reduces the current position realizes profit
+        int64_t closing = 0;
+        if (p.quantity && (p.quantity > 0) != (quantity > 0))
+            closing = (quantity > 0 ? 1 : -1) * std::min(std::abs(quantity), std::abs(p.quantity));
+
+        if (closing)
+        {
+            const double average = p.cost / static_cast<double>(p.quantity);
+            realized   += (price - average) * static_cast<double>(-closing);
+            p.quantity += closing;
+            p.cost      = average * static_cast<double>(p.quantity);
+        }
+
+        const int64_t opening = quantity - closing;
+        p.quantity += opening;
+        p.cost     += static_cast<double>(opening) * price;
+
+        market     += static_cast<double>(quantity) * price;
+        cost_basis += p.cost - old_cost;
+        cash       -= static_cast<double>(quantity) * price + fee;
+        fees       += fee;
+
+        if (!p.quantity)
+        {
+            cost_basis -= p.cost;
+            positions.erase(company);
+        }
+    }
+
+    void mark(const util::id_t& company, double price)
+    {
+        const auto it = positions.find(company);
+        if (it == positions.end()) return;
+
+        market += static_cast<double>(it->second.quantity) * (price - it->second.price);
+        it->second.price = price;
+    }
+
+    // recompute the running sums from the open positions, O(positions)
+    void revalue()
+    {
+        market = 0.0;
+        cost_basis = 0.0;
+        for (const auto& p : positions)
+        {
+            market     += static_cast<double>(p.second.quantity) * p.second.price;
+            cost_basis += p.second.cost;
+        }
+    }
+
+    double unrealized() const { return market - cost_basis; }
+    double profit()     const { return realized + unrealized() - fees; }
+    double value()      const { return cash + market; }
+};
+
+}
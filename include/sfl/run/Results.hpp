@@ -0,0 +1,331 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+#include <sfl/def.hpp>
+
+#include "Execution.hpp"
+
+/*
+
+Results files are a sequence of column blocks:
+
+<---- HEADER ---->
+char[4]  magic    -- "SFLR"
+uint16_t version  -- version of the results format
+{
+    uint8_t  kind   -- 1 for fills, 2 for equity points
+    uint32_t count  -- rows in this block
+    {
+        fills:  uint64_t order[count], uint32_t company[count], std::size_t time[count],
+                int64_t quantity[count], double price[count], double commission[count]
+        equity: std::size_t time[count], double cash[count], double market[count]
+    }
+} blocks[]
+
+*/
+
+namespace sfl
+{
+
+#define RESULTS_VERSION 1
+
+// Discards everything, every call compiles away
+struct NullSink
+{
+    void fill(const Fill&) {}
+    void equity(std::size_t, double, double) {}
+    void flush() {}
+};
+
+namespace detail
+{
+
+struct ResultBlock
+{
+    std::vector<Order::id_type> order;
+    std::vector<util::id_t>     company;
+    std::vector<std::size_t>    fill_time;
+    std::vector<int64_t>        quantity;
+    std::vector<double>         price, commission;
+
+    std::vector<std::size_t> time;
+    std::vector<double>      cash, market;
+
+    ResultBlock(std::size_t capacity)
+    {
+        order.reserve(capacity);
+        company.reserve(capacity);
+        fill_time.reserve(capacity);
+        quantity.reserve(capacity);
+        price.reserve(capacity);
+        commission.reserve(capacity);
+
+        time.reserve(capacity);
+        cash.reserve(capacity);
+        market.reserve(capacity);
+    }
+
+    void clear()
+    {
+        order.clear(); company.clear(); fill_time.clear(); quantity.clear(); price.clear(); commission.clear();
+        time.clear(); cash.clear(); market.clear();
+    }
+
+    bool empty() const { return order.empty() && time.empty(); }
+};
+
+template<typename T>
+void write_column(std::ofstream& f, const std::vector<T>& column)
+{
+    f.write(reinterpret_cast<const char*>(column.data()), sizeof(T) * column.size());
+}
+
+template<typename T>
+void read_column(std::ifstream& f, std::vector<T>& column, uint32_t count)
+{
+    column.resize(count);
+    f.read(reinterpret_cast<char*>(column.data()), sizeof(T) * count);
+}
+
+} // namespace detail
+
+/*
+
+Appends into preallocated column blocks. A full block is handed to a
+background thread which writes it out and returns it to the pool; if the
+writer falls behind a new block is allocated rather than waiting on it, so
+the calling thread never waits on the disk. Fills and equity arriving before
+open() or after close() are dropped.
+
+*/
+struct FileSink
+{
+    FileSink(std::size_t _block_size = 1 << 16) :
+        block_size(_block_size)
+    {   }
+
+    FileSink(const std::string& filename, std::size_t _block_size = 1 << 16) :
+        block_size(_block_size)
+    {
+        open(filename);
+    }
+
+    FileSink(FileSink&&) = delete;
+    FileSink(const FileSink&) = delete;
+
+    ~FileSink()
+    {
+        close();
+    }
+
+    void open(const std::string& filename)
+    {
+        close();
+
+        file.open(filename, std::ios_base::out | std::ios_base::binary);
+        assert(file);
+
+        file.write("SFLR", 4);
+        const uint16_t version = RESULTS_VERSION;
+        file.write(reinterpret_cast<const char*>(&version), sizeof(uint16_t));
+
+        done = false;
+        current = take();
+        writer = std::thread([this]() { run(); });
+    }
+
+    void close()
+    {
+        if (!writer.joinable()) return;
+
+        flush();
+        {
+            std::lock_guard lock(mutex);
+            done = true;
+        }
+        ready.notify_one();
+        writer.join();
+
+        file.close();
+        current.reset();
+    }
+
+    void fill(const Fill& f)
+    {
+        if (!current) return;
+
+        current->order.push_back(f.order);
+        current->company.push_back(f.company);
+        current->fill_time.push_back(f.time);
+        current->quantity.push_back(f.quantity);
+        current->price.push_back(f.price);
+        current->commission.push_back(f.commission);
+
+        if (current->order.size() == block_size) flush();
+    }
+
+    void equity(std::size_t time, double cash, double market)
+    {
+        if (!current) return;
+
+        current->time.push_back(time);
+        current->cash.push_back(cash);
+        current->market.push_back(market);
+
+        if (current->time.size() == block_size) flush();
+    }
+
+    // Hands the current block to the writer thread
+    void flush()
+    {
+        if (!current || current->empty()) return;
+
+        {
+            std::lock_guard lock(mutex);
+            pending.push_back(std::move(current));
+        }
+        ready.notify_one();
+
+        current = take();
+    }
+
+    // Converts a results file into <prefix>_fills.csv and <prefix>_equity.csv
+    static void exportCSV(const std::string& filename, const std::string& prefix)
+    {
+        using namespace detail;
+
+        std::ifstream f(filename, std::ios_base::in | std::ios_base::binary);
+        assert(f);
+
+        char magic[4];
+        f.read(magic, 4);
+        assert(std::string(magic, 4) == "SFLR");
+
+        uint16_t version;
+        f.read(reinterpret_cast<char*>(&version), sizeof(uint16_t));
+        assert(version == RESULTS_VERSION);
+
+        std::ofstream fills(prefix + "_fills.csv"), equity(prefix + "_equity.csv");
+        fills  << "order,company,time,quantity,price,commission\n";
+        equity << "time,cash,market,equity\n";
+        fills.precision(10);
+        equity.precision(10);
+
+        ResultBlock block(0);
+        uint8_t kind;
+        while (f.read(reinterpret_cast<char*>(&kind), sizeof(uint8_t)))
+        {
+            uint32_t count;
+            f.read(reinterpret_cast<char*>(&count), sizeof(uint32_t));
+
+            if (kind == 1)
+            {
+                read_column(f, block.order, count);
+                read_column(f, block.company, count);
+                read_column(f, block.fill_time, count);
+                read_column(f, block.quantity, count);
+                read_column(f, block.price, count);
+                read_column(f, block.commission, count);
+
+                for (uint32_t i = 0; i < count; i++)
+                    fills << block.order[i] << "," << block.company[i] << "," << block.fill_time[i] << ","
+                          << block.quantity[i] << "," << block.price[i] << "," << block.commission[i] << "\n";
+            }
+            else
+            {
+                assert(kind == 2);
+                read_column(f, block.time, count);
+                read_column(f, block.cash, count);
+                read_column(f, block.market, count);
+
+                for (uint32_t i = 0; i < count; i++)
+                    equity << block.time[i] << "," << block.cash[i] << "," << block.market[i] << ","
+                           << block.cash[i] + block.market[i] << "\n";
+            }
+        }
+    }
+
+private:
+    using Block = std::unique_ptr<detail::ResultBlock>;
+
+    Block take()
+    {
+        {
+            std::lock_guard lock(mutex);
+            if (!pool.empty())
+            {
+                auto b = std::move(pool.back());
+                pool.pop_back();
+                return b;
+            }
+        }
+        return std::make_unique<detail::ResultBlock>(block_size);
+    }
+
+    void run()
+    {
+        using namespace detail;
+
+        while (true)
+        {
+            Block block;
+            {
+                std::unique_lock lock(mutex);
+                ready.wait(lock, [&]() { return done || !pending.empty(); });
+                if (pending.empty()) return;
+
+                block = std::move(pending.front());
+                pending.pop_front();
+            }
+
+            if (!block->order.empty())
+            {
+                write_header(1, block->order.size());
+                write_column(file, block->order);
+                write_column(file, block->company);
+                write_column(file, block->fill_time);
+                write_column(file, block->quantity);
+                write_column(file, block->price);
+                write_column(file, block->commission);
+            }
+
+            if (!block->time.empty())
+            {
+                write_header(2, block->time.size());
+                write_column(file, block->time);
+                write_column(file, block->cash);
+                write_column(file, block->market);
+            }
+
+            block->clear();
+
+            std::lock_guard lock(mutex);
+            pool.push_back(std::move(block));
+        }
+    }
+
+    void write_header(uint8_t kind, std::size_t count)
+    {
+        const auto c = static_cast<uint32_t>(count);
+        file.write(reinterpret_cast<const char*>(&kind), sizeof(uint8_t));
+        file.write(reinterpret_cast<const char*>(&c), sizeof(uint32_t));
+    }
+
+    std::size_t block_size;
+    std::ofstream file;
+
+    Block current;
+    std::deque<Block> pending;
+    std::vector<Block> pool;
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::thread writer;
+    bool done = false;
+};
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <sfl/def.hpp>
+
+namespace sfl
+{
+
+struct Timepoint
+{
+    time_t time;
+    double price;
+    double open, high, low, close, volume;
+    bool   interpolated = false; // no bar was recorded at this time
+    //util::id_t datapoint;
+};
+
+// Allocations of every Stop's points
+struct StopMemory
+{
+    static util::memory::Account& account()
+    {
+        static util::memory::Account& a = util::memory::registry().add("Driver stops");
+        return a;
+    }
+};
+
+struct Stop
+{
+    using Points = std::unordered_map<
+        util::id_t, Timepoint, std::hash<util::id_t>, std::equal_to<util::id_t>,
+        util::memory::Allocator<std::pair<const util::id_t, Timepoint>, StopMemory>>;
+
+    std::size_t time;
+    Points points;
+    //std::vector<Timepoint> points;
+};  
+
+}
@@ -0,0 +1,524 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <sfl/def.hpp>
+#include <sfl/data/Schema.hpp>
+#include <sfl/util/Factory.hpp>
+
+#include "Metrics.hpp"
+
+namespace sfl
+{
+
+/*
+
+The points of a parameter sweep: every combination of the values given for
+each parameter. Point i is i written in mixed radix, the first parameter
+varying fastest, so a coordinator and its workers agree on a point from its
+index alone.
+
+*/
+struct Grid
+{
+    std::vector<std::string> names;
+    std::vector<std::vector<double>> values;
+
+    Grid& add(std::string name, std::vector<double> v)
+    {
+        assert(!v.empty());
+        names.push_back(std::move(name));
+        values.push_back(std::move(v));
+        return *this;
+    }
+
+    std::size_t size() const
+    {
+        if (values.empty()) return 0;
+
+        std::size_t n = 1;
+        for (const auto& v : values) n *= v.size();
+        return n;
+    }
+
+    std::vector<double> point(std::size_t i) const
+    {
+        std::vector<double> p(values.size());
+        for (std::size_t k = 0; k < values.size(); k++)
+        {
+            p[k] = values[k][i % values[k].size()];
+            i /= values[k].size();
+        }
+        return p;
+    }
+};
+
+// One backtest of a sweep, run in a worker process
+using SweepJob = std::function<Summary(const std::vector<double>& point)>;
+
+struct SweepOptions
+{
+    std::size_t workers  = std::max(1u, std::thread::hardware_concurrency()); // local worker processes
+    std::size_t depth    = 2; // points in flight per worker, so none waits on the coordinator for its next one
+    std::size_t attempts = 3; // a point that takes down this many workers is given up
+    uint16_t    port     = 0; // when set, workers on other nodes can join over TCP, see joinSweep
+};
+
+struct SweepResult
+{
+    std::vector<Summary> summaries; // by point
+    std::vector<uint8_t> completed; // by point, 0 for the points given up
+    std::size_t crashes = 0, reassigned = 0, failed = 0;
+
+    // completed point with the highest metric
+    std::optional<std::size_t> best(double Summary::* metric = &Summary::sharpe) const
+    {
+        std::optional<std::size_t> b;
+        for (std::size_t i = 0; i < summaries.size(); i++)
+            if (completed[i] && (!b || summaries[i].*metric > summaries[*b].*metric))
+                b = i;
+        return b;
+    }
+};
+
+namespace detail
+{
+
+/*
+
+The sweep protocol, fixed size little endian messages over a stream socket:
+
+    worker -> coordinator  hello   uint64_t points in the worker's grid
+    coordinator -> worker  assign  uint32_t point, or `sweep_stop` to exit
+    worker -> coordinator  result  uint32_t point, then the Summary: periods
+                                   and trades as uint64_t, the rest as double
+
+*/
+constexpr uint32_t    sweep_stop  = std::numeric_limits<uint32_t>::max();
+constexpr std::size_t hello_size  = sizeof(uint64_t);
+constexpr std::size_t assign_size = sizeof(uint32_t);
+
+inline constexpr double Summary::* summary_doubles[] = {
+    &Summary::total_return, &Summary::mean_return, &Summary::volatility, &Summary::sharpe,
+    &Summary::sortino, &Summary::max_drawdown, &Summary::exposure, &Summary::turnover
+};
+
+constexpr std::size_t result_size = sizeof(uint32_t) + 2 * sizeof(uint64_t) + std::size(summary_doubles) * sizeof(double);
+
+inline void encodeResult(char* out, uint32_t point, const Summary& s)
+{
+    schema::store<uint32_t>(out, point);
+    schema::store<uint64_t>(out + 4,  s.periods);
+    schema::store<uint64_t>(out + 12, s.trades);
+
+    char* it = out + 20;
+    for (const auto member : summary_doubles)
+    {
+        schema::store<double>(it, s.*member);
+        it += sizeof(double);
+    }
+}
+
+inline std::pair<uint32_t, Summary> decodeResult(const char* in)
+{
+    Summary s;
+    s.periods = static_cast<std::size_t>(schema::load<uint64_t>(in + 4));
+    s.trades  = static_cast<std::size_t>(schema::load<uint64_t>(in + 12));
+
+    const char* it = in + 20;
+    for (const auto member : summary_doubles)
+    {
+        s.*member = schema::load<double>(it);
+        it += sizeof(double);
+    }
+    return { schema::load<uint32_t>(in), s };
+}
+
+// Whole messages, false once the other side is gone. Never raises SIGPIPE.
+inline bool sendAll(int fd, const char* data, std::size_t size)
+{
+    while (size)
+    {
+        const auto n = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+inline bool receiveAll(int fd, char* data, std::size_t size)
+{
+    while (size)
+    {
+        const auto n = ::recv(fd, data, size, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+inline void tuneSocket(int fd)
+{
+    int yes = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    ::setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &yes, sizeof(yes));
+}
+
+/*
+
+A worker's side: says hello, then runs the points it's sent until told to
+stop. Every run starts from an empty universe, as in a fresh process.
+Returns false if the coordinator went away first.
+
+*/
+inline bool work(int fd, const Grid& grid, const SweepJob& job)
+{
+    char buffer[result_size];
+    schema::store<uint64_t>(buffer, grid.size());
+    if (!sendAll(fd, buffer, hello_size)) return false;
+
+    while (true)
+    {
+        if (!receiveAll(fd, buffer, assign_size)) return false;
+
+        const auto point = schema::load<uint32_t>(buffer);
+        if (point == sweep_stop) return true;
+
+        const auto summary = job(grid.point(point));
+        util::Universe::clear();
+
+        encodeResult(buffer, point, summary);
+        if (!sendAll(fd, buffer, result_size)) return false;
+    }
+}
+
+// Flushed before forking, so the children don't inherit and repeat buffered output
+inline void flushOutput()
+{
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+}
+
+// Leaves a forked child without running the parent's exit handlers (the trace writer) a second time
+[[noreturn]] inline void exitChild(bool ok)
+{
+    flushOutput();
+    ::_exit(ok ? 0 : 1);
+}
+
+} // namespace detail
+
+/*
+
+Runs every point of a grid in worker processes and merges their summaries.
+
+`options.workers` local workers are forked, each talking to the coordinator
+over a socketpair; with `options.port` set, workers on other nodes can also
+join over TCP with joinSweep. Each worker has its own Universe, so runs are
+as isolated as separate programs, and a job reading its data through
+Driver(filename, Slices{...}) maps the file, so every worker on a node
+shares one copy of it in the page cache instead of loading its own.
+
+Workers send back a fixed size record per point, which `progress` sees as
+it arrives. A worker that dies or disconnects has its points in flight
+handed to the others, and a local one is replaced; a point that takes down
+`options.attempts` workers is given up and left out of the result.
+
+Call it before starting any threads, since the workers are forked.
+
+*/
+inline SweepResult sweep(const Grid& grid, const SweepJob& job, const SweepOptions& options = {},
+    const std::function<void(std::size_t, const Summary&)>& progress = {})
+{
+    using namespace detail;
+
+    const auto points = grid.size();
+    assert(points < sweep_stop);
+
+    SweepResult result;
+    result.summaries.resize(points);
+    result.completed.assign(points, 0);
+
+    std::vector<std::size_t> attempts(points, 0);
+    std::deque<uint32_t> pending;
+    for (std::size_t i = 0; i < points; i++)
+        pending.push_back(static_cast<uint32_t>(i));
+    std::size_t remaining = points;
+
+    struct Worker
+    {
+        int   fd;
+        pid_t pid   = -1; // -1 for remote workers
+        bool  ready = false;
+        std::vector<uint32_t> inflight;
+        std::string buffer;
+    };
+    std::vector<Worker> workers;
+
+    int listener = -1;
+    if (options.port)
+    {
+        listener = ::socket(AF_INET, SOCK_STREAM, 0);
+        assert(listener >= 0);
+
+        int yes = 1;
+        ::setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+        sockaddr_in address{};
+        address.sin_family      = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port        = htons(options.port);
+
+        if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener, 64) != 0)
+        {
+            std::cerr << "sweep: can't listen on port " << options.port << '\n';
+            ::close(listener);
+            listener = -1;
+        }
+    }
+
+    const auto spawn = [&]()
+    {
+        int fds[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) return;
+
+        flushOutput();
+        const pid_t pid = ::fork();
+        if (pid == 0)
+        {
+            ::close(fds[0]);
+            for (const auto& w : workers) ::close(w.fd);
+            if (listener >= 0) ::close(listener);
+
+            exitChild(work(fds[1], grid, job));
+        }
+
+        ::close(fds[1]);
+        if (pid < 0)
+        {
+            ::close(fds[0]);
+            return;
+        }
+        workers.push_back(Worker{ .fd = fds[0], .pid = pid });
+    };
+
+    // a worker that's gone: its points go back to the front of the queue in the order they were handed
+    // out; a worker runs them one at a time, so only the first was running and is charged an attempt
+    std::size_t replacements = 0;
+    const auto lose = [&](Worker& w)
+    {
+        ::close(w.fd);
+        w.fd = -1;
+        if (w.pid > 0)
+        {
+            ::waitpid(w.pid, nullptr, 0);
+            replacements++;
+        }
+        result.crashes++;
+
+        for (std::size_t i = w.inflight.size(); i-- > 0;)
+        {
+            const auto point = w.inflight[i];
+            if (i == 0 && ++attempts[point] >= options.attempts)
+            {
+                result.failed++;
+                remaining--;
+                continue;
+            }
+            pending.push_front(point);
+            result.reassigned++;
+        }
+        w.inflight.clear();
+    };
+
+    const auto feed = [&](Worker& w)
+    {
+        char buffer[assign_size];
+        while (w.fd >= 0 && w.ready && w.inflight.size() < options.depth && !pending.empty())
+        {
+            const auto point = pending.front();
+            schema::store<uint32_t>(buffer, point);
+            if (!sendAll(w.fd, buffer, assign_size)) return; // its hang up shows up in poll
+
+            pending.pop_front();
+            w.inflight.push_back(point);
+        }
+    };
+
+    for (std::size_t i = 0; i < options.workers; i++) spawn();
+
+    std::vector<pollfd> polled;
+    char chunk[1 << 12];
+    while (remaining > 0 && (!workers.empty() || listener >= 0))
+    {
+        polled.clear();
+        for (const auto& w : workers) polled.push_back(pollfd{ w.fd, POLLIN, 0 });
+        if (listener >= 0) polled.push_back(pollfd{ listener, POLLIN, 0 });
+
+        if (::poll(polled.data(), polled.size(), -1) < 0)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        for (std::size_t i = 0; i < workers.size(); i++)
+        {
+            if (!polled[i].revents) continue;
+            auto& w = workers[i];
+
+            const auto n = ::recv(w.fd, chunk, sizeof(chunk), 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0)
+            {
+                lose(w);
+                continue;
+            }
+            w.buffer.append(chunk, static_cast<std::size_t>(n));
+
+            std::size_t used = 0;
+            if (!w.ready)
+            {
+                if (w.buffer.size() < hello_size) continue;
+                if (schema::load<uint64_t>(w.buffer.data()) != points)
+                {
+                    std::cerr << "sweep: a worker has a different grid, dropped\n";
+                    lose(w);
+                    continue;
+                }
+                w.ready = true;
+                used = hello_size;
+            }
+
+            for (; w.buffer.size() - used >= result_size; used += result_size)
+            {
+                const auto [point, summary] = decodeResult(w.buffer.data() + used);
+                std::erase(w.inflight, point);
+
+                // a point handed out again may come back twice, the first one counts
+                if (point >= points || result.completed[point]) continue;
+
+                result.completed[point] = 1;
+                result.summaries[point] = summary;
+                remaining--;
+                if (progress) progress(point, summary);
+            }
+            w.buffer.erase(0, used);
+        }
+
+        if (listener >= 0 && polled.back().revents)
+        {
+            const int fd = ::accept(listener, nullptr, nullptr);
+            if (fd >= 0)
+            {
+                tuneSocket(fd);
+                workers.push_back(Worker{ .fd = fd });
+            }
+        }
+
+        std::erase_if(workers, [](const Worker& w) { return w.fd < 0; });
+        for (; replacements && remaining > 0; replacements--) spawn();
+        replacements = 0;
+
+        for (auto& w : workers) feed(w);
+    }
+
+    char stop[assign_size];
+    schema::store<uint32_t>(stop, sweep_stop);
+    for (const auto& w : workers)
+    {
+        sendAll(w.fd, stop, assign_size);
+        ::close(w.fd);
+        if (w.pid > 0) ::waitpid(w.pid, nullptr, 0);
+    }
+    if (listener >= 0) ::close(listener);
+
+    return result;
+}
+
+/*
+
+Joins the sweep of a coordinator on another node (or this one) with
+`processes` workers, and returns once the sweep is over. The grid and job
+must be the same as the coordinator's: only point indices go over the wire.
+Returns false if a worker couldn't connect or lost the coordinator.
+
+*/
+inline bool joinSweep(const std::string& host, uint16_t port, const Grid& grid, const SweepJob& job, std::size_t processes = 1)
+{
+    using namespace detail;
+
+    const auto connect = [&]() -> int
+    {
+        addrinfo hints{};
+        hints.ai_family   = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        addrinfo* list = nullptr;
+        if (::getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &list) != 0) return -1;
+
+        int fd = -1;
+        for (auto* a = list; a && fd < 0; a = a->ai_next)
+        {
+            fd = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+            if (fd >= 0 && ::connect(fd, a->ai_addr, a->ai_addrlen) != 0)
+            {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+        ::freeaddrinfo(list);
+
+        if (fd >= 0) tuneSocket(fd);
+        return fd;
+    };
+
+    const auto run = [&]()
+    {
+        const int fd = connect();
+        if (fd < 0) return false;
+
+        const bool ok = work(fd, grid, job);
+        ::close(fd);
+        return ok;
+    };
+
+    std::vector<pid_t> children;
+    for (std::size_t i = 1; i < processes; i++)
+    {
+        flushOutput();
+        const pid_t pid = ::fork();
+        if (pid == 0) exitChild(run());
+        if (pid > 0) children.push_back(pid);
+    }
+
+    bool ok = run();
+    for (const auto pid : children)
+    {
+        int status = 0;
+        ::waitpid(pid, &status, 0);
+        ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+    return ok;
+}
+
+}
@@ -2,7 +2,9 @@
 
 #include "data/File.hpp"
 #include "data/API.hpp"
+#include "data/Ingest.hpp"
 
 #include "run/Driver.hpp"
+#include "run/Sweep.hpp"
 
 #include "util/Time.hpp"
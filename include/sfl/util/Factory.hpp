@@ -7,6 +7,8 @@
 #include <cstdlib>
 #include <type_traits>
 
+#include "Memory.hpp"
+
 namespace util
 {
     using id_t = uint32_t;
@@ -25,12 +27,17 @@ namespace util
 
             assert(!type_objects.count(id));
             auto* obj = new T(id, std::forward<Args>(args)...);
+            memory::Objects<T>::account().add(sizeof(T));
             type_objects.insert(std::pair(
                 id,
                 std::shared_ptr<void>(
                     reinterpret_cast<void*>(obj),
                     [](void* ptr)
-                    { delete reinterpret_cast<T*>(ptr); }
+                    { 
+                        delete reinterpret_cast<T*>(ptr);
+                        memory::Objects<T>::account().remove(sizeof(T));
+                    },
+                    memory::Allocator<char, memory::ControlBlocks<T>>()
                 )
             ));
 
@@ -79,6 +86,7 @@ namespace util
                 if (p.second == id)
                     return p.first;
             assert(false);
+            return {};
         }
 
         inline static bool
@@ -92,20 +100,48 @@ namespace util
         {
             bool found = false;
             for (auto& types : objects)
-                for (const auto& objs : types.second)
-                    if (id == objs.first)
-                    {
-                        objects.at(types.first).erase(id);
-                        found = true;
-                        break;
-                    }
-            
+                if (types.second.erase(id))
+                {
+                    found = true;
+                    break;
+                }
+
             assert(found);
         }
 
+        // Destroys a named object and frees its name
+        inline static void
+        destroy(const std::string& name)
+        {
+            assert(names.count(name));
+            destroy(names.at(name));
+            names.erase(name);
+        }
+
+        // Drops every object and name, ids keep counting up so stale ids never alias new objects
+        inline static void
+        clear()
+        {
+            objects.clear();
+            names.clear();
+        }
+
     private:
+        struct Index
+        {
+            static memory::Account& account()
+            {
+                static memory::Account& a = memory::registry().add("Universe index");
+                return a;
+            }
+        };
+
+        using TypeObjects = std::unordered_map<
+            id_t, std::shared_ptr<void>, std::hash<id_t>, std::equal_to<id_t>,
+            memory::Allocator<std::pair<const id_t, std::shared_ptr<void>>, Index>>;
+
         inline static id_t counter = 1;
-        inline static std::unordered_map<std::size_t, std::unordered_map<id_t, std::shared_ptr<void>>> objects;
+        inline static std::unordered_map<std::size_t, TypeObjects> objects;
         inline static std::unordered_map<std::string, id_t> names;
     };
 
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cassert>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace util
+{
+
+// Read-only memory map of a whole file
+struct MappedFile
+{
+    MappedFile(const std::string& filename)
+    {
+        fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return;
+
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            size = static_cast<std::size_t>(st.st_size);
+            void* ptr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+            if (ptr == MAP_FAILED) size = 0;
+            else
+            {
+                data = reinterpret_cast<const char*>(ptr);
+                ::madvise(ptr, size, MADV_SEQUENTIAL);
+            }
+        }
+    }
+
+    MappedFile(MappedFile&&) = delete;
+    MappedFile(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+        if (data) ::munmap(const_cast<char*>(data), size);
+        if (fd >= 0) ::close(fd);
+    }
+
+    explicit operator bool() const { return fd >= 0; }
+
+    std::string_view view() const { return std::string_view(data, size); }
+
+private:
+    int fd = -1;
+    const char* data = nullptr;
+    std::size_t size = 0;
+};
+
+}
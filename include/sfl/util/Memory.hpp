@@ -0,0 +1,191 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <typeinfo>
+
+#if __has_include(<cxxabi.h>)
+#include <cxxabi.h>
+#endif
+
+namespace util
+{
+
+namespace memory
+{
+
+/*
+
+Bytes currently held by one kind of allocation, how many objects (or, for
+containers, allocations) they are, and the most bytes it ever held. Updates are relaxed atomics, accounts are created once
+and never move, so holding on to a reference is safe.
+
+*/
+struct Account
+{
+    Account(std::string _name) :
+        name(std::move(_name))
+    {   }
+
+    void add(int64_t bytes, int64_t objects = 1);
+    void remove(int64_t bytes, int64_t objects = 1);
+
+    // Starts a new peak from what is held right now
+    void resetPeak() { peak.store(bytes.load(std::memory_order_relaxed), std::memory_order_relaxed); }
+
+    const std::string name;
+    std::atomic<int64_t> bytes   = 0;
+    std::atomic<int64_t> objects = 0;
+    std::atomic<int64_t> peak    = 0;
+};
+
+struct Registry
+{
+    Account& add(const std::string& name)
+    {
+        std::lock_guard lock(mutex);
+        return accounts.emplace_back(name);
+    }
+
+    template<typename F>
+    void each(F&& f)
+    {
+        std::lock_guard lock(mutex);
+        for (auto& a : accounts) f(a);
+    }
+
+    // every tracked byte, whatever account it belongs to
+    Account total{ "total" };
+
+private:
+    std::mutex mutex;
+    std::deque<Account> accounts;
+};
+
+// never destroyed, objects released during static destruction still book to it
+inline Registry& registry()
+{
+    static Registry* r = new Registry();
+    return *r;
+}
+
+inline void raisePeak(std::atomic<int64_t>& peak, int64_t value)
+{
+    auto current = peak.load(std::memory_order_relaxed);
+    while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed));
+}
+
+inline void Account::add(int64_t n, int64_t count)
+{
+    raisePeak(peak, bytes.fetch_add(n, std::memory_order_relaxed) + n);
+    objects.fetch_add(count, std::memory_order_relaxed);
+
+    auto& total = registry().total;
+    raisePeak(total.peak, total.bytes.fetch_add(n, std::memory_order_relaxed) + n);
+    total.objects.fetch_add(count, std::memory_order_relaxed);
+}
+
+inline void Account::remove(int64_t n, int64_t count)
+{
+    bytes.fetch_sub(n, std::memory_order_relaxed);
+    objects.fetch_sub(count, std::memory_order_relaxed);
+
+    auto& total = registry().total;
+    total.bytes.fetch_sub(n, std::memory_order_relaxed);
+    total.objects.fetch_sub(count, std::memory_order_relaxed);
+}
+
+inline std::string demangle(const char* name)
+{
+#if __has_include(<cxxabi.h>)
+    int status = 0;
+    std::unique_ptr<char, void(*)(void*)> readable(abi::__cxa_demangle(name, nullptr, nullptr, &status), std::free);
+    if (status == 0 && readable) return readable.get();
+#endif
+    return name;
+}
+
+// Objects of a Factory type, and the shared_ptr control blocks that own them
+template<typename T>
+struct Objects
+{
+    static Account& account()
+    {
+        static Account& a = registry().add(demangle(typeid(T).name()) + " objects");
+        return a;
+    }
+};
+
+template<typename T>
+struct ControlBlocks
+{
+    static Account& account()
+    {
+        static Account& a = registry().add(demangle(typeid(T).name()) + " control blocks");
+        return a;
+    }
+};
+
+/*
+
+Allocator that books every allocation to the account of `Tag`, a type with a
+static account(). It's stateless, so containers using it stay as small as
+with std::allocator and compare equal across instances.
+
+*/
+template<typename T, typename Tag>
+struct Allocator
+{
+    using value_type = T;
+
+    Allocator() = default;
+
+    template<typename U>
+    Allocator(const Allocator<U, Tag>&) noexcept {}
+
+    template<typename U>
+    struct rebind { using other = Allocator<U, Tag>; };
+
+    T* allocate(std::size_t n)
+    {
+        Tag::account().add(static_cast<int64_t>(n * sizeof(T)));
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        Tag::account().remove(static_cast<int64_t>(n * sizeof(T)));
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    template<typename U>
+    bool operator==(const Allocator<U, Tag>&) const noexcept { return true; }
+};
+
+// Prints every account with its current and peak size
+inline void report(std::ostream& out)
+{
+    const auto mib = [](int64_t bytes) { return static_cast<double>(bytes) / (1 << 20); };
+
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-44s %12s %12s %12s\n", "account", "count", "MiB", "peak MiB");
+    out << line;
+
+    const auto print = [&](const Account& a)
+    {
+        std::snprintf(line, sizeof(line), "%-44s %12lld %12.2f %12.2f\n", a.name.c_str(),
+            static_cast<long long>(a.objects.load()), mib(a.bytes.load()), mib(a.peak.load()));
+        out << line;
+    };
+
+    registry().each([&](const Account& a) { if (a.peak.load()) print(a); });
+    print(registry().total);
+}
+
+} // namespace memory
+
+} // namespace util
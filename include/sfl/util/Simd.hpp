@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+
+#if __has_include(<experimental/simd>)
+#include <experimental/simd>
+#define SFL_HAS_SIMD 1
+#endif
+
+namespace util
+{
+
+#ifdef SFL_HAS_SIMD
+namespace stdx = std::experimental;
+using vdouble = stdx::native_simd<double>;
+#endif
+
+// Sum of n doubles, SIMD lanes when the standard library has them
+inline double sum(const double* data, std::size_t n)
+{
+    double total = 0.0;
+    std::size_t i = 0;
+
+#ifdef SFL_HAS_SIMD
+    vdouble acc = 0.0;
+    for (; i + vdouble::size() <= n; i += vdouble::size())
+        acc += vdouble(data + i, stdx::element_aligned);
+    total = stdx::reduce(acc);
+#endif
+
+    for (; i < n; i++) total += data[i];
+    return total;
+}
+
+// Sum of squared deviations of n doubles from a center
+inline double squares(const double* data, std::size_t n, double center)
+{
+    double total = 0.0;
+    std::size_t i = 0;
+
+#ifdef SFL_HAS_SIMD
+    vdouble acc = 0.0;
+    for (; i + vdouble::size() <= n; i += vdouble::size())
+    {
+        const auto d = vdouble(data + i, stdx::element_aligned) - center;
+        acc += d * d;
+    }
+    total = stdx::reduce(acc);
+#endif
+
+    for (; i < n; i++) total += (data[i] - center) * (data[i] - center);
+    return total;
+}
+
+}
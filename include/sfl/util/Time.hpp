@@ -2,6 +2,11 @@
 
 #include <ctime>
 #include <string>
+#include <string_view>
+#include <optional>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
 
 namespace sfl
 {
@@ -14,4 +19,302 @@ std::string stringify(time_t t, const std::string& str)
     return std::string(c);
 }
 
-}
\ No newline at end of file
+/*
+
+Civil calendar arithmetic (proleptic Gregorian, UTC). No libc time zone
+calls, so none of this depends on TZ or the locale and all of it is
+constexpr. Algorithms from Howard Hinnant's "chrono-Compatible Low-Level
+Date Algorithms".
+
+*/
+struct Civil
+{
+    int32_t  year;
+    uint32_t month, day;
+};
+
+constexpr int64_t daysFromCivil(int32_t y, uint32_t m, uint32_t d)
+{
+    y -= (m <= 2);
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const uint32_t yoe = static_cast<uint32_t>(y - era * 400);
+    const uint32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+constexpr Civil civilFromDays(int64_t z)
+{
+    z += 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const uint32_t doe = static_cast<uint32_t>(z - era * 146097);
+    const uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const int64_t y = static_cast<int64_t>(yoe) + era * 400;
+    const uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const uint32_t mp = (5 * doy + 2) / 153;
+    const uint32_t d = doy - (153 * mp + 2) / 5 + 1;
+    const uint32_t m = (mp < 10 ? mp + 3 : mp - 9);
+    return Civil{ static_cast<int32_t>(y + (m <= 2)), m, d };
+}
+
+// 0 is Sunday
+constexpr uint32_t weekday(int64_t days)
+{
+    return static_cast<uint32_t>(days >= -4 ? (days + 4) % 7 : (days + 5) % 7 + 6);
+}
+
+constexpr int64_t floorDiv(int64_t a, int64_t b)
+{
+    return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+}
+
+/*
+
+Parses "YYYY-MM-DD", "YYYY-MM-DDTHH:MM[:SS[.fff]]" with an optional "Z",
+"+HH", "+HHMM" or "+HH:MM" offset (a space is accepted instead of the "T").
+Fractional seconds are dropped. Returns seconds since the epoch in UTC.
+
+*/
+constexpr std::optional<int64_t> parseISO8601(std::string_view s)
+{
+    std::size_t i = 0;
+    bool ok = true;
+
+    const auto digits = [&](std::size_t count) -> int32_t
+    {
+        int32_t v = 0;
+        for (std::size_t k = 0; k < count; k++, i++)
+        {
+            if (i >= s.size() || s[i] < '0' || s[i] > '9') { ok = false; return 0; }
+            v = v * 10 + (s[i] - '0');
+        }
+        return v;
+    };
+
+    const auto expect = [&](char c)
+    {
+        if (i < s.size() && s[i] == c) { i++; return true; }
+        return false;
+    };
+
+    const auto year = digits(4);
+    if (!expect('-')) return std::nullopt;
+    const auto month = digits(2);
+    if (!expect('-')) return std::nullopt;
+    const auto day = digits(2);
+    if (!ok || month < 1 || month > 12 || day < 1 || day > 31) return std::nullopt;
+
+    int64_t seconds = daysFromCivil(year, static_cast<uint32_t>(month), static_cast<uint32_t>(day)) * 86400;
+    if (i == s.size()) return seconds;
+
+    if (!expect('T') && !expect(' ')) return std::nullopt;
+
+    const auto hour = digits(2);
+    if (!expect(':')) return std::nullopt;
+    const auto minute = digits(2);
+    const auto second = (expect(':') ? digits(2) : 0);
+    if (!ok || hour > 23 || minute > 59 || second > 60) return std::nullopt;
+
+    if (expect('.'))
+        while (i < s.size() && s[i] >= '0' && s[i] <= '9') i++;
+
+    seconds += hour * 3600 + minute * 60 + second;
+    if (i == s.size() || expect('Z')) return (i == s.size() ? std::optional<int64_t>(seconds) : std::nullopt);
+
+    const bool negative = (s[i] == '-');
+    if (!expect('+') && !expect('-')) return std::nullopt;
+
+    const auto offset_hour = digits(2);
+    expect(':');
+    const auto offset_minute = (i < s.size() ? digits(2) : 0);
+    if (!ok || i != s.size()) return std::nullopt;
+
+    const int64_t offset = offset_hour * 3600 + offset_minute * 60;
+    return seconds + (negative ? offset : -offset);
+}
+
+/*
+
+Writes "YYYY-MM-DDTHH:MM:SSZ" (20 characters, no terminator) and returns the
+amount written.
+
+*/
+constexpr std::size_t formatISO8601(int64_t t, char* out)
+{
+    const auto days = floorDiv(t, 86400);
+    const auto secs = t - days * 86400;
+    const auto date = civilFromDays(days);
+
+    const auto put = [&](std::size_t at, uint32_t v, std::size_t count)
+    {
+        for (std::size_t k = count; k > 0; k--, v /= 10)
+            out[at + k - 1] = static_cast<char>('0' + v % 10);
+    };
+
+    put(0, static_cast<uint32_t>(date.year), 4);
+    out[4] = '-';
+    put(5, date.month, 2);
+    out[7] = '-';
+    put(8, date.day, 2);
+    out[10] = 'T';
+    put(11, static_cast<uint32_t>(secs / 3600), 2);
+    out[13] = ':';
+    put(14, static_cast<uint32_t>(secs / 60 % 60), 2);
+    out[16] = ':';
+    put(17, static_cast<uint32_t>(secs % 60), 2);
+    out[19] = 'Z';
+    return 20;
+}
+
+inline std::string formatISO8601(int64_t t)
+{
+    std::string s(20, '\0');
+    formatISO8601(t, s.data());
+    return s;
+}
+
+// "30m", "1h", "1d", "1w" (or plain seconds) to seconds, nullopt if malformed
+constexpr std::optional<int64_t> parseInterval(std::string_view s)
+{
+    int64_t n = 0;
+    std::size_t i = 0;
+    for (; i < s.size() && s[i] >= '0' && s[i] <= '9'; i++)
+        n = n * 10 + (s[i] - '0');
+
+    if (i == 0 || n == 0 || i + 1 < s.size()) return std::nullopt;
+    if (i == s.size()) return n;
+
+    switch (s[i])
+    {
+    case 's': return n;
+    case 'm': return n * 60;
+    case 'h': return n * 3600;
+    case 'd': return n * 86400;
+    case 'w': return n * 7 * 86400;
+    }
+    return std::nullopt;
+}
+
+// A comma separated list of intervals, nullopt if any of them is malformed
+inline std::optional<std::vector<int64_t>> parseIntervals(std::string_view s)
+{
+    std::vector<int64_t> intervals;
+    while (!s.empty())
+    {
+        const auto comma = std::min(s.find(','), s.size());
+        const auto interval = parseInterval(s.substr(0, comma));
+        if (!interval) return std::nullopt;
+
+        intervals.push_back(*interval);
+        s.remove_prefix(std::min(comma + 1, s.size()));
+    }
+    return intervals;
+}
+
+/*
+
+Trading session calendar of an exchange. Sessions are given in exchange
+local time, which is a fixed UTC offset plus an optional daylight saving
+rule. Weekends and listed holidays have no session.
+
+*/
+struct Calendar
+{
+    enum class DST
+    {
+        None, 
+        US,   // second Sunday of March to first Sunday of November, 2am local
+        EU    // last Sunday of March to last Sunday of October, 1am UTC
+    };
+
+    int32_t  utc_offset = 0;          // seconds, standard time
+    DST      dst        = DST::None;
+    uint32_t open       = 9 * 3600 + 30 * 60; // seconds after local midnight
+    uint32_t close      = 16 * 3600;
+    uint8_t  weekend    = (1 << 0) | (1 << 6); // bit per weekday, Sunday first
+
+    std::vector<int64_t> holidays; // local days since the epoch, sorted
+
+    static Calendar nyse()
+    {
+        return Calendar{ .utc_offset = -5 * 3600, .dst = DST::US };
+    }
+
+    static Calendar always()
+    {
+        return Calendar{ .open = 0, .close = 86400, .weekend = 0 };
+    }
+
+    void holiday(int32_t y, uint32_t m, uint32_t d)
+    {
+        const auto day = daysFromCivil(y, m, d);
+        holidays.insert(std::upper_bound(holidays.begin(), holidays.end(), day), day);
+    }
+
+    // Seconds between UTC and local time at the given UTC time
+    int32_t offset(int64_t t) const
+    {
+        if (dst == DST::None) return utc_offset;
+
+        const auto year = civilFromDays(floorDiv(t + utc_offset, 86400)).year;
+        int64_t start, end;
+
+        if (dst == DST::US)
+        {
+            start = nthSunday(year, 3, 2) * 86400 + 2 * 3600 - utc_offset;
+            end   = nthSunday(year, 11, 1) * 86400 + 2 * 3600 - (utc_offset + 3600);
+        }
+        else
+        {
+            start = lastSunday(year, 3) * 86400 + 3600;
+            end   = lastSunday(year, 10) * 86400 + 3600;
+        }
+
+        return utc_offset + (t >= start && t < end ? 3600 : 0);
+    }
+
+    bool tradingDay(int64_t local_day) const
+    {
+        if (weekend & (1 << weekday(local_day))) return false;
+        return !std::binary_search(holidays.begin(), holidays.end(), local_day);
+    }
+
+    bool isOpen(int64_t t) const
+    {
+        const auto local = t + offset(t);
+        const auto day = floorDiv(local, 86400);
+        const auto secs = static_cast<uint32_t>(local - day * 86400);
+        return tradingDay(day) && secs >= open && secs < close;
+    }
+
+    // The first session open at or after t
+    int64_t nextOpen(int64_t t) const
+    {
+        if (isOpen(t)) return t;
+
+        const auto off = offset(t);
+        auto day = floorDiv(t + off, 86400);
+        if (t + off - day * 86400 >= open) day++;
+
+        while (!tradingDay(day)) day++;
+
+        // the offset may differ on the opening day
+        const auto guess = day * 86400 + open - off;
+        return day * 86400 + open - offset(guess);
+    }
+
+private:
+    static int64_t nthSunday(int32_t y, uint32_t m, uint32_t n)
+    {
+        const auto first = daysFromCivil(y, m, 1);
+        return first + (7 - weekday(first)) % 7 + (n - 1) * 7;
+    }
+
+    static int64_t lastSunday(int32_t y, uint32_t m)
+    {
+        const auto last = daysFromCivil(y + (m == 12), m % 12 + 1, 1) - 1;
+        return last - weekday(last);
+    }
+};
+
+}
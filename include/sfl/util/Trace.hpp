@@ -0,0 +1,267 @@
+#pragma once
+
+/*
+
+Hot-path tracing. Build with SFL_TRACE defined to record every
+SFL_TRACE_SCOPE (a timed region) and SFL_TRACE_COUNTER (a sampled value);
+without it both expand to nothing and cost nothing.
+
+Each thread appends to its own buffer, a list of fixed size chunks that is
+only ever written by that thread, so recording takes no lock: one clock read
+and a store. Buffers belong to a global registry and outlive their threads.
+At exit the events are written as Chrome trace JSON (open it in
+chrome://tracing or ui.perfetto.dev) to $SFL_TRACE_FILE, or sfl_trace.json,
+and a table of the time spent per scope goes to stderr.
+
+Names must be string literals, only the pointer is stored.
+
+*/
+
+#ifdef SFL_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace util
+{
+
+namespace trace
+{
+
+inline int64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Event
+{
+    const char* name;
+    int64_t begin;    // ns
+    int64_t duration; // ns, < 0 for counters
+    double  value;
+};
+
+struct Buffer
+{
+    static constexpr std::size_t chunk_size = 1 << 14;
+
+    struct Chunk
+    {
+        Event events[chunk_size];
+        std::atomic<std::size_t> size = 0;
+        std::atomic<Chunk*> next = nullptr;
+    };
+
+    Buffer(uint32_t _thread) :
+        thread(_thread),
+        head(std::make_unique<Chunk>()),
+        tail(head.get())
+    {   }
+
+    ~Buffer()
+    {
+        auto* c = head->next.load();
+        while (c)
+        {
+            auto* next = c->next.load();
+            delete c;
+            c = next;
+        }
+    }
+
+    void push(const Event& e)
+    {
+        auto size = tail->size.load(std::memory_order_relaxed);
+        if (size == chunk_size)
+        {
+            auto* chunk = new Chunk();
+            tail->next.store(chunk, std::memory_order_release);
+            tail = chunk;
+            size = 0;
+        }
+
+        tail->events[size] = e;
+        tail->size.store(size + 1, std::memory_order_release);
+    }
+
+    template<typename F>
+    void each(F&& f) const
+    {
+        for (const Chunk* c = head.get(); c; c = c->next.load(std::memory_order_acquire))
+        {
+            const auto size = c->size.load(std::memory_order_acquire);
+            for (std::size_t i = 0; i < size; i++) f(c->events[i]);
+        }
+    }
+
+    uint32_t thread;
+
+private:
+    std::unique_ptr<Chunk> head;
+    Chunk* tail;
+};
+
+struct Registry
+{
+    ~Registry()
+    {
+        const char* path = std::getenv("SFL_TRACE_FILE");
+        exportChrome(path ? path : "sfl_trace.json");
+        summary(stderr);
+    }
+
+    Buffer* add()
+    {
+        std::lock_guard lock(mutex);
+        buffers.push_back(std::make_unique<Buffer>(static_cast<uint32_t>(buffers.size())));
+        return buffers.back().get();
+    }
+
+    void exportChrome(const std::string& filename)
+    {
+        std::lock_guard lock(mutex);
+
+        std::FILE* f = std::fopen(filename.c_str(), "w");
+        if (!f) return;
+
+        // timestamps start at the first event
+        int64_t origin = std::numeric_limits<int64_t>::max();
+        for (const auto& b : buffers)
+            b->each([&](const Event& e) { origin = std::min(origin, e.begin); });
+
+        bool first = true;
+        std::fputs("{\"traceEvents\":[\n", f);
+        for (const auto& b : buffers)
+            b->each([&](const Event& e)
+            {
+                const double ts = static_cast<double>(e.begin - origin) * 1e-3;
+                if (e.duration >= 0)
+                    std::fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                        first ? "" : ",\n", e.name, ts, static_cast<double>(e.duration) * 1e-3, b->thread);
+                else
+                    std::fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"value\":%.17g}}",
+                        first ? "" : ",\n", e.name, ts, b->thread, e.value);
+                first = false;
+            });
+        std::fputs("\n]}\n", f);
+        std::fclose(f);
+    }
+
+    void summary(std::FILE* out)
+    {
+        struct Row
+        {
+            std::size_t count = 0;
+            int64_t total = 0, longest = 0;
+            double sum = 0, last = 0;
+            bool counter = false;
+        };
+
+        std::map<std::string, Row> rows;
+        {
+            std::lock_guard lock(mutex);
+            for (const auto& b : buffers)
+                b->each([&](const Event& e)
+                {
+                    auto& r = rows[e.name];
+                    r.count++;
+                    if (e.duration >= 0)
+                    {
+                        r.total  += e.duration;
+                        r.longest = std::max(r.longest, e.duration);
+                    }
+                    else
+                    {
+                        r.counter = true;
+                        r.sum += e.value;
+                        r.last = e.value;
+                    }
+                });
+        }
+
+        if (rows.empty()) return;
+
+        std::fprintf(out, "\n%-24s %10s %12s %12s %12s\n", "scope", "count", "total ms", "mean us", "max us");
+        for (const auto& [name, r] : rows)
+            if (!r.counter)
+                std::fprintf(out, "%-24s %10zu %12.3f %12.3f %12.3f\n", name.c_str(), r.count,
+                    r.total * 1e-6, r.total * 1e-3 / r.count, r.longest * 1e-3);
+
+        std::fprintf(out, "\n%-24s %10s %12s %12s\n", "counter", "samples", "sum", "last");
+        for (const auto& [name, r] : rows)
+            if (r.counter)
+                std::fprintf(out, "%-24s %10zu %12.0f %12.0f\n", name.c_str(), r.count, r.sum, r.last);
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Buffer>> buffers;
+};
+
+inline Registry& registry()
+{
+    static Registry r;
+    return r;
+}
+
+inline Buffer& buffer()
+{
+    thread_local Buffer* b = registry().add();
+    return *b;
+}
+
+inline void complete(const char* name, int64_t begin, int64_t end)
+{
+    buffer().push(Event{ name, begin, end - begin, 0.0 });
+}
+
+inline void counter(const char* name, double value)
+{
+    buffer().push(Event{ name, now(), -1, value });
+}
+
+struct Scope
+{
+    Scope(const char* _name) :
+        name(_name),
+        begin(now())
+    {   }
+
+    ~Scope()
+    {
+        complete(name, begin, now());
+    }
+
+    const char* name;
+    int64_t begin;
+};
+
+} // namespace trace
+
+} // namespace util
+
+#define SFL_TRACE_CONCAT_(a, b) a##b
+#define SFL_TRACE_CONCAT(a, b) SFL_TRACE_CONCAT_(a, b)
+
+#define SFL_TRACE_SCOPE(name) ::util::trace::Scope SFL_TRACE_CONCAT(sfl_trace_scope_, __LINE__)(name)
+#define SFL_TRACE_COUNTER(name, value) ::util::trace::counter(name, static_cast<double>(value))
+#define SFL_TRACE_NOW() ::util::trace::now()
+#define SFL_TRACE_COMPLETE(name, begin) ::util::trace::complete(name, begin, ::util::trace::now())
+
+#else
+
+#define SFL_TRACE_SCOPE(name) ((void)0)
+#define SFL_TRACE_COUNTER(name, value) ((void)0)
+#define SFL_TRACE_NOW() int64_t(0)
+#define SFL_TRACE_COMPLETE(name, begin) ((void)0)
+
+#endif
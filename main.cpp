@@ -4,11 +4,9 @@ using namespace sfl;
 
 struct Test : BaseStrategy
 {
-    bool bought = false;
-
     Test()
     {
-        principal = 1000.0;
+        portfolio.cash = 1000.0;
     }
 
     bool direction = 0; // 0 for down, 1 for up
@@ -17,7 +15,12 @@ struct Test : BaseStrategy
 
     uint32_t index = 0;
 
-    // Simple strategy that buys if we're at a bottom and sells a stock if it makes over 10%
+    void filled(const Fill& fill) override
+    {
+        std::cout << (fill.quantity > 0 ? "Bought " : "Sold ") << Company::get(fill.company)->name << " on " << sfl::stringify(fill.time, "%b %e, %Y") << " for $" << fill.price << "\n";
+    }
+
+    // Simple strategy that buys if we're at a bottom and sells the position if it makes over 10%
     void step() override
     {
         if (!index) { index++; return; }
@@ -30,37 +33,20 @@ struct Test : BaseStrategy
                 if (last_price < c.second.price && !direction)
                 {
                     direction = 1;
-                    if (buy(c.first))
-                        std::cout << "Bought Microsoft on " << sfl::stringify(current_stop.time, "%b %e, %Y") << " for $" << c.second.price << "\n";
+                    buy(c.first);
                 }
                 else if (last_price > c.second.price && direction)
                 {
                     direction = 0;
-                    std::vector<double> profits(owned.size());
-                    for (uint32_t i = 0; i < profits.size(); i++)
-                        profits[i] = (owned[i].current_value - owned[i].bought.price) / owned[i].bought.price;
-
-                    const auto it = std::max_element(profits.begin(), profits.end());
-                    if (*it > 0.1)
-                        if (sell(owned.begin() + std::distance(profits.begin(), it)))
-                            std::cout << "Sold Microsoft on " << sfl::stringify(current_stop.time, "%b %e, %Y") << " for $" << c.second.price << "\n";
+                    const auto* position = portfolio.position(c.first);
+                    if (position && (c.second.price * position->quantity - position->cost) / position->cost > 0.1)
+                        sell(c.first, position->quantity);
                 }
 
                 last_price = c.second.price;
             }
         }
 
-        const auto value = [&](const Stop& current_stop) -> double
-        {
-            double v = principal;
-            for (const auto& s : owned)
-                v += s.current_value;
-            return v;
-        };
-
-        const auto perc_change = (value(current_stop) - 1000.0) / 1000.0 * 100.0;
-        std::cout << sfl::stringify(current_stop.time, "%b %e, %Y %r") << " - " << "Portfolio value: $" << value(current_stop) << " " << (perc_change > 0 ? "+" : "-") << "%" << perc_change << "\n";
-
         index++;
     }
 };
@@ -69,8 +55,14 @@ int main()
 {
     //addCompany("MSFT", 2023);
 
-    Driver<Test> driver(DATABASE_DIR "/2023.sft");
+    // the equity curve and fills go to a binary results file instead of the console,
+    // use FileSink::exportCSV to get them as CSV
+    Driver<Test, FileSink> driver(DATABASE_DIR "/2023.sft");
+    driver.sink.open(DATABASE_DIR "/2023.results");
     driver.run();
+    driver.sink.close();
+
+    std::cout << driver.summary() << "\n";
 }
 
 #if 0
@@ -0,0 +1,73 @@
+#include <sfl/data/Synthetic.hpp>
+
+#include <chrono>
+#include <filesystem>
+
+using namespace sfl;
+
+/*
+
+sfl-generate [-t tickers] [-e exchanges] [-y first year] [-n years] [-i interval minutes]
+             [-m missing ratio] [-d drift] [-v volatility] [-c correlation] [-s seed]
+             [-j threads] [-r rollups] [-p double|float|ticks] [--sessions] <output directory>
+
+Writes one <year>.sft of synthetic tickers per year. Rollups are a list of
+intervals such as 1h,1d,1w, -p picks how prices are stored.
+
+*/
+int main(int argc, char** argv)
+{
+    SyntheticOptions options;
+    std::vector<std::string> positional;
+    std::optional<std::vector<int64_t>> rollups = std::vector<int64_t>();
+    std::optional<PriceFormat> prices = PriceFormat::Double;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if      (arg == "-t" && i + 1 < argc) options.tickers     = std::stoul(argv[++i]);
+        else if (arg == "-e" && i + 1 < argc) options.exchanges   = std::stoul(argv[++i]);
+        else if (arg == "-y" && i + 1 < argc) options.first_year  = std::stoi(argv[++i]);
+        else if (arg == "-n" && i + 1 < argc) options.years       = std::stoul(argv[++i]);
+        else if (arg == "-i" && i + 1 < argc) options.interval    = std::stol(argv[++i]) * 60;
+        else if (arg == "-m" && i + 1 < argc) options.missing     = std::stod(argv[++i]);
+        else if (arg == "-d" && i + 1 < argc) options.drift       = std::stod(argv[++i]);
+        else if (arg == "-v" && i + 1 < argc) options.volatility  = std::stod(argv[++i]);
+        else if (arg == "-c" && i + 1 < argc) options.correlation = std::stod(argv[++i]);
+        else if (arg == "-s" && i + 1 < argc) options.seed        = std::stoull(argv[++i]);
+        else if (arg == "-j" && i + 1 < argc) options.threads     = std::stoul(argv[++i]);
+        else if (arg == "-r" && i + 1 < argc) rollups = parseIntervals(argv[++i]);
+        else if (arg == "-p" && i + 1 < argc) prices  = parsePriceFormat(argv[++i]);
+        else if (arg == "--sessions") options.sessions = true;
+        else positional.push_back(arg);
+    }
+
+    if (positional.size() != 1 || options.correlation < 0.0 || options.correlation > 1.0 || !rollups || !prices)
+    {
+        std::cerr << "usage: sfl-generate [-t tickers] [-e exchanges] [-y first year] [-n years] [-i interval minutes]\n"
+                     "                    [-m missing ratio] [-d drift] [-v volatility] [-c correlation 0..1] [-s seed]\n"
+                     "                    [-j threads] [-r rollups] [-p double|float|ticks] [--sessions] <output directory>\n";
+        return 1;
+    }
+
+    options.rollups = *rollups;
+    options.prices  = *prices;
+
+    std::filesystem::create_directories(positional[0]);
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto result = generateSynthetic(positional[0], options);
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::size_t bytes = 0;
+    for (const auto& f : result.files)
+    {
+        std::cout << "wrote " << f << "\n";
+        bytes += std::filesystem::file_size(f);
+    }
+
+    std::cout << result.bars << " bars for " << options.tickers << " tickers, "
+              << bytes / (1 << 20) << " MiB in " << seconds << "s\n";
+
+    return 0;
+}
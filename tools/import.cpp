@@ -0,0 +1,108 @@
+#include <sfl/data/Import.hpp>
+
+#include <chrono>
+#include <filesystem>
+
+using namespace sfl;
+
+/*
+
+sfl-import [-j threads] [-e exchange] [-d delimiter] [-r rollups] [-p double|float|ticks] [-c]
+           <output directory> <file.csv>...
+
+Writes one <year>.sft per year found in the inputs. Rollups are a list of
+intervals such as 1h,1d,1w, -p picks how prices are stored. With -c every
+written file is loaded, written again and reloaded, and must come back with
+the same companies and bars.
+
+*/
+
+// Tickers and bar counts of every company of a file, in file order
+static std::vector<std::pair<std::string, std::size_t>> contents(const File& file)
+{
+    std::vector<std::pair<std::string, std::size_t>> companies;
+    for (const auto id : file.companies)
+    {
+        const auto it = file.datapoints.find(id);
+        companies.emplace_back(Company::get(id)->ticker, (it == file.datapoints.end() ? 0 : it->second.size()));
+    }
+    std::sort(companies.begin(), companies.end());
+    return companies;
+}
+
+// Loads a file, writes it back out and loads the copy; share classes of one issuer must stay apart
+static bool roundTrip(const std::string& filename)
+{
+    const auto copy = filename + ".check";
+
+    util::Universe::clear();
+    File file;
+    file.load(filename);
+    const auto before = contents(file);
+    file.write(copy);
+
+    util::Universe::clear();
+    File reloaded;
+    reloaded.load(copy);
+    const auto after = contents(reloaded);
+
+    util::Universe::clear();
+    std::filesystem::remove(copy);
+    return before == after;
+}
+int main(int argc, char** argv)
+{
+    ImportOptions options;
+    std::vector<std::string> positional;
+    std::optional<std::vector<int64_t>> rollups = std::vector<int64_t>();
+    std::optional<PriceFormat> prices = PriceFormat::Double;
+    bool check = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if      (arg == "-j" && i + 1 < argc) options.threads   = std::stoul(argv[++i]);
+        else if (arg == "-e" && i + 1 < argc) options.exchange  = argv[++i];
+        else if (arg == "-d" && i + 1 < argc) options.delimiter = argv[++i][0];
+        else if (arg == "-r" && i + 1 < argc) rollups = parseIntervals(argv[++i]);
+        else if (arg == "-p" && i + 1 < argc) prices  = parsePriceFormat(argv[++i]);
+        else if (arg == "-c") check = true;
+        else positional.push_back(arg);
+    }
+
+    if (positional.size() < 2 || !rollups || !prices)
+    {
+        std::cerr << "usage: sfl-import [-j threads] [-e exchange] [-d delimiter] [-r rollups] [-p double|float|ticks] [-c]\n"
+                     "                  <output directory> <file.csv>...\n";
+        return 1;
+    }
+
+    options.rollups = *rollups;
+    options.prices  = *prices;
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto result = importCSV(
+        std::vector<std::string>(positional.begin() + 1, positional.end()), 
+        positional[0], 
+        options);
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (const auto& f : result.files)
+        std::cout << "wrote " << f << "\n";
+
+    std::cout << result.rows << " bars for " << result.tickers << " tickers in " << seconds << "s";
+    if (result.rejected) std::cout << " (" << result.rejected << " rows rejected)";
+    std::cout << "\n";
+
+    if (!check) return 0;
+
+    bool ok = true;
+    for (const auto& f : result.files)
+    {
+        const bool same = roundTrip(f);
+        std::cout << f << (same ? ": round trip ok\n" : ": companies or bars changed in a load/write round trip\n");
+        ok = ok && same;
+    }
+
+    return (ok ? 0 : 1);
+}
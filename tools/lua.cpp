@@ -0,0 +1,42 @@
+#include <sfl/run/Lua.hpp>
+
+#include <chrono>
+
+using namespace sfl;
+
+/*
+
+sfl-lua [-i interval] <script.lua> <file.sft>
+
+Backtests a Lua strategy over a file and prints its summary. The interval
+(e.g. 1h) picks bars from the file's rollups instead of the stored bars;
+tools/momentum.lua is an example script.
+
+*/
+int main(int argc, char** argv)
+{
+    std::vector<std::string> positional;
+    std::optional<int64_t> interval = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if (arg == "-i" && i + 1 < argc) interval = parseInterval(argv[++i]);
+        else positional.push_back(arg);
+    }
+
+    if (positional.size() != 2 || !interval)
+    {
+        std::cerr << "usage: sfl-lua [-i interval] <script.lua> <file.sft>\n";
+        return 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    Driver<LuaStrategy> driver(positional[1], Resolution{ *interval }, positional[0]);
+    driver.run();
+
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << driver.summary() << "\n" << driver.curve().size() << " stops in " << seconds << "s\n";
+    return 0;
+}
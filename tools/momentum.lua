@@ -0,0 +1,26 @@
+-- Buys a column up more than `threshold` over `lag` stops, sells it once it's down as much.
+-- Run it with: sfl-lua tools/momentum.lua <file.sft>
+
+local lag, threshold = 4, 0.005
+local history
+
+function start(width)
+    history = {}
+end
+
+function step()
+    history[ctx.row] = { table.unpack(prices) }
+
+    local past = history[ctx.row - lag]
+    if not past then return end
+    history[ctx.row - lag] = nil
+
+    for c = 1, #prices do
+        local change = prices[c] / past[c] - 1
+        if change > threshold and positions[c] == 0 then
+            buy(c, 10)
+        elseif change < -threshold and positions[c] > 0 then
+            sell(c, positions[c])
+        end
+    end
+end
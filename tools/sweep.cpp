@@ -0,0 +1,144 @@
+#include <sfl/run/Driver.hpp>
+#include <sfl/run/Sweep.hpp>
+
+#include <chrono>
+#include <charconv>
+
+using namespace sfl;
+
+/*
+
+sfl-sweep [-j workers] [-l lags] [-x thresholds] [-s slice days] [-i interval]
+          [--listen port | --join host:port] <file.sft>
+
+Sweeps a momentum strategy over every (lag, threshold) pair of the lists,
+one out-of-core backtest per pair in worker processes. With --listen, nodes
+running the same command with --join add their -j workers to the sweep.
+
+*/
+
+// Buys a column up more than `threshold` over `lag` stops, sells it once it's down as much
+struct Momentum : BaseStrategy
+{
+    Momentum(std::size_t _lag, double _threshold) :
+        lag(_lag), threshold(_threshold)
+    {
+        portfolio.cash = 1'000'000.0;
+    }
+
+    void step() override
+    {
+        if (row < lag) return;
+
+        for (std::size_t c = 0; c < panel->width(); c++)
+        {
+            const auto now = price(c), then = panel->price(row - lag, c);
+            if (!(then > 0.0)) continue;
+
+            const auto company = panel->companies[c];
+            const auto change  = now / then - 1.0;
+            if (change > threshold && !portfolio.quantity(company)) buy(company, 10);
+            else if (change < -threshold && portfolio.quantity(company) > 0) sell(company, portfolio.quantity(company));
+        }
+    }
+
+    std::size_t lag;
+    double threshold;
+};
+
+static std::optional<std::vector<double>> parseList(std::string_view s)
+{
+    std::vector<double> values;
+    while (!s.empty())
+    {
+        const auto comma = s.find(',');
+        const auto item  = s.substr(0, comma);
+
+        double v = 0.0;
+        const auto [end, error] = std::from_chars(item.data(), item.data() + item.size(), v);
+        if (error != std::errc() || end != item.data() + item.size()) return std::nullopt;
+        values.push_back(v);
+
+        s = (comma == std::string_view::npos ? std::string_view() : s.substr(comma + 1));
+    }
+
+    if (values.empty()) return std::nullopt;
+    return values;
+}
+
+int main(int argc, char** argv)
+{
+    SweepOptions options;
+    std::vector<std::string> positional;
+    std::optional<std::vector<double>> lags = std::vector<double>{ 1, 2, 4, 8 };
+    std::optional<std::vector<double>> thresholds = std::vector<double>{ 0.001, 0.005, 0.01 };
+    std::optional<int64_t> interval = 0;
+    int64_t slice_days = 7;
+    std::string join;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if      (arg == "-j" && i + 1 < argc) options.workers = std::stoul(argv[++i]);
+        else if (arg == "-l" && i + 1 < argc) lags       = parseList(argv[++i]);
+        else if (arg == "-x" && i + 1 < argc) thresholds = parseList(argv[++i]);
+        else if (arg == "-s" && i + 1 < argc) slice_days = std::stol(argv[++i]);
+        else if (arg == "-i" && i + 1 < argc) interval   = parseInterval(argv[++i]);
+        else if (arg == "--listen" && i + 1 < argc) options.port = static_cast<uint16_t>(std::stoul(argv[++i]));
+        else if (arg == "--join"   && i + 1 < argc) join = argv[++i];
+        else positional.push_back(arg);
+    }
+
+    const auto colon = join.rfind(':');
+    if (positional.size() != 1 || !lags || !thresholds || !interval || slice_days <= 0 ||
+        (!join.empty() && colon == std::string::npos))
+    {
+        std::cerr << "usage: sfl-sweep [-j workers] [-l lags] [-x thresholds] [-s slice days] [-i interval]\n"
+                     "                 [--listen port | --join host:port] <file.sft>\n";
+        return 1;
+    }
+
+    Grid grid;
+    grid.add("lag", *lags).add("threshold", *thresholds);
+
+    const auto filename = positional[0];
+    const Slices slices{ .seconds = slice_days * 24 * 3600, .interval = *interval };
+
+    const SweepJob job = [&](const std::vector<double>& point)
+    {
+        const auto lag = static_cast<std::size_t>(std::max(point[0], 1.0));
+
+        // the lag has to stay in the window carried between slices
+        auto s = slices;
+        s.lookback = lag;
+
+        Driver<Momentum> driver(filename, s, lag, point[1]);
+        driver.run();
+        return driver.summary();
+    };
+
+    if (!join.empty())
+    {
+        const auto port = static_cast<uint16_t>(std::stoul(join.substr(colon + 1)));
+        return (joinSweep(join.substr(0, colon), port, grid, job, options.workers) ? 0 : 1);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto result = sweep(grid, job, options, [&](std::size_t i, const Summary& s)
+    {
+        const auto p = grid.point(i);
+        std::cout << "lag " << p[0] << ", threshold " << p[1] << ": " << s << "\n";
+    });
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (const auto best = result.best())
+    {
+        const auto p = grid.point(*best);
+        std::cout << "best: lag " << p[0] << ", threshold " << p[1] << ", " << result.summaries[*best] << "\n";
+    }
+
+    std::cout << grid.size() - result.failed << " of " << grid.size() << " runs in " << seconds << "s, "
+              << result.crashes << " workers lost, " << result.reassigned << " runs reassigned\n";
+
+    return (result.failed ? 1 : 0);
+}